@@ -41,6 +41,7 @@
 
 #include "detail/Debug.h"
 #include "Ethernet_HTTPClient/Ethernet_HttpClient.h"
+#include "Ethernet_HTTPClient/Ethernet_HttpClientPool.h"
 #include "Ethernet_HTTPClient/Ethernet_WebSocketClient.h"
 #include "Ethernet_HTTPClient/Ethernet_URLEncoder.h"
 
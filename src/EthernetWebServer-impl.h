@@ -37,6 +37,11 @@
 #include <libb64/cencode.h>
 #include "EthernetWebServer.hpp"
 #include "detail/RequestHandlersImpl.h"
+#include "detail/RouteTree.h"
+#include "detail/StaticRouter.h"
+#include "detail/CachedResponse.h"
+#include "detail/StaticAssets.h"
+#include "detail/Deflate.h"
 #include "detail/Debug.h"
 #include "detail/mimetable.h"
 
@@ -80,9 +85,17 @@ EthernetWebServer::EthernetWebServer(int port)
   , _server(port)
   , _currentMethod(HTTP_ANY)
   , _currentVersion(0)
+  , _currentStatus(HC_NONE)
+  , _statusChange(0)
+#if USE_NEW_WEBSERVER_VERSION
+  , _nextConnection(0)
+#endif
+  , _keepAlive(false)
   , _currentHandler(0)
   , _firstHandler(0)
   , _lastHandler(0)
+  , _routes(0)
+  , _staticRouter(0)
   , _currentArgCount(0)
   , _currentArgs(0)
   , _headerKeysCount(0)
@@ -91,15 +104,40 @@ EthernetWebServer::EthernetWebServer(int port)
   , _clientContentLength(0)
   , _chunked(false)
 {
+  _pathArgs.count = 0;
+
+#if USE_NEW_WEBSERVER_VERSION
+
+  for (uint8_t i = 0; i < ETHERNET_WEBSERVER_MAX_CLIENTS; i++)
+  {
+    _connections[i].status       = HCS_FREE;
+    _connections[i].statusChange = 0;
+  }
+
+#endif
 }
 
 ////////////////////////////////////////
 
 EthernetWebServer::~EthernetWebServer()
 {
+  // close() first, it may still touch _currentHeaders
+  close();
+
   if (_currentHeaders)
     delete[]_currentHeaders;
 
+  _currentHeaders = nullptr;
+
+#if USE_NEW_WEBSERVER_VERSION
+
+  if (_headerSlices)
+    delete[] _headerSlices;
+
+  _headerSlices = nullptr;
+
+#endif
+
   _headerKeysCount = 0;
   ethernetRequestHandler* handler = _firstHandler;
 
@@ -110,7 +148,19 @@ EthernetWebServer::~EthernetWebServer()
     handler = next;
   }
 
-  close();
+  if (_routes)
+    delete _routes;
+
+  _routes = nullptr;
+
+#if (HTTP_DEFLATE_WINDOW > 0)
+
+  if (_deflate)
+    delete _deflate;
+
+  _deflate = nullptr;
+
+#endif
 }
 
 ////////////////////////////////////////
@@ -203,7 +253,38 @@ void EthernetWebServer::on(const String &uri, HTTPMethod method, EthernetWebServ
 void EthernetWebServer::on(const String &uri, HTTPMethod method, EthernetWebServer::THandlerFunction fn,
                            EthernetWebServer::THandlerFunction ufn)
 {
-  _addRequestHandler(new ethernetFunctionRequestHandler(fn, ufn, uri, method));
+  if (!_routes)
+    _routes = new ethernetRouteNode();
+
+  _routes->add(uri, new ethernetRouteHandler(fn, ufn, method));
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::onStatic(const String& uri, int code, const char* content_type, const String& content)
+{
+  onStatic(uri, code, content_type, content.c_str(), content.length());
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::onStatic(const String& uri, int code, const char* content_type, const char* content,
+                                 size_t contentLength)
+{
+  if (!_routes)
+    _routes = new ethernetRouteNode();
+
+  _routes->add(uri, new ethernetCachedResponseHandler(code, content_type, content, contentLength, false));
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::onStatic_P(const String& uri, int code, const char* content_type, PGM_P content)
+{
+  if (!_routes)
+    _routes = new ethernetRouteNode();
+
+  _routes->add(uri, new ethernetCachedResponseHandler(code, content_type, content, strlen_P(content), true));
 }
 
 ////////////////////////////////////////
@@ -215,6 +296,13 @@ void EthernetWebServer::addHandler(ethernetRequestHandler* handler)
 
 ////////////////////////////////////////
 
+void EthernetWebServer::setStaticRouter(ethernetRequestHandler& router)
+{
+  _staticRouter = &router;
+}
+
+////////////////////////////////////////
+
 void EthernetWebServer::_addRequestHandler(ethernetRequestHandler* handler)
 {
   if (!_lastHandler)
@@ -231,6 +319,34 @@ void EthernetWebServer::_addRequestHandler(ethernetRequestHandler* handler)
 
 ////////////////////////////////////////
 
+// The static router is tried first, then the routes registered by on() in the route tree,
+// then handlers added by addHandler() and serveStatic() in order
+ethernetRequestHandler* EthernetWebServer::_findHandler()
+{
+  ethernetRequestHandler* handler = nullptr;
+
+  _pathArgs.count = 0;
+
+  if (_staticRouter && _staticRouter->canHandle(_currentMethod, _currentUri))
+    return _staticRouter;
+
+  if (_routes)
+    handler = _routes->find(_currentMethod, _currentUri.c_str(), _pathArgs);
+
+  if (!handler)
+  {
+    for (handler = _firstHandler; handler; handler = handler->next())
+    {
+      if (handler->canHandle(_currentMethod, _currentUri))
+        break;
+    }
+  }
+
+  return handler;
+}
+
+////////////////////////////////////////
+
 //KH
 #if USE_NEW_WEBSERVER_VERSION
 
@@ -238,98 +354,275 @@ void EthernetWebServer::_addRequestHandler(ethernetRequestHandler* handler)
 
 void EthernetWebServer::handleClient()
 {
-  if (_currentStatus == HC_NONE)
+  _acceptClient();
+
+  bool callYield = false;
+
+  // Service every active slot once per call, starting from a different slot each time
+  // so that a slow client can't starve the others
+  for (uint8_t i = 0; i < ETHERNET_WEBSERVER_MAX_CLIENTS; i++)
   {
-    EthernetClient client = _server.available();
+    ethernetHTTPConnection& conn = _connections[(_nextConnection + i) % ETHERNET_WEBSERVER_MAX_CLIENTS];
+
+    // Answer the requests a client pipelined behind the first one while their bytes are already here
+    for (uint8_t served = 0; (served < HTTP_PIPELINE_DEPTH) && (conn.status != HCS_FREE); served++)
+    {
+      uint16_t requestCount = conn.requestCount;
+
+      callYield |= _handleConnection(conn);
+
+      if ( (conn.requestCount == requestCount) || !( (conn.rxPos < conn.rxLen) || conn.client.available() ) )
+        break;
+    }
+  }
+
+  _nextConnection = (_nextConnection + 1) % ETHERNET_WEBSERVER_MAX_CLIENTS;
+
+  if (callYield)
+  {
+    yield();
+  }
+}
+
+////////////////////////////////////////
+
+// EthernetServer::accept() of Ethernet 2.x, Ethernet_Generic and QNEthernet returns each new connection once.
+// Other libraries only have available(), which returns a socket with unread data, maybe one already served
+template<typename T>
+static auto ethernetServerAccept(T& server, int) -> decltype(server.accept())
+{
+  return server.accept();
+}
+
+template<typename T>
+static EthernetClient ethernetServerAccept(T& server, long)
+{
+  return server.available();
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_acceptClient()
+{
+  // Take as many new clients as there are free slots, a socket already being served doesn't hide the others
+  for (uint8_t tries = 0; tries <= ETHERNET_WEBSERVER_MAX_CLIENTS; tries++)
+  {
+    uint8_t freeSlot = ETHERNET_WEBSERVER_MAX_CLIENTS;
+
+    for (uint8_t i = 0; i < ETHERNET_WEBSERVER_MAX_CLIENTS; i++)
+    {
+      if (_connections[i].status == HCS_FREE)
+      {
+        freeSlot = i;
+        break;
+      }
+    }
+
+    if (freeSlot == ETHERNET_WEBSERVER_MAX_CLIENTS)
+    {
+      // All slots busy, leave the client queued in its socket until one is released
+      ET_LOGDEBUG(F("handleClient: No free connection slot"));
+
+      return;
+    }
+
+    EthernetClient client = ethernetServerAccept(_server, 0);
 
     if (!client)
     {
       return;
     }
 
-    ET_LOGDEBUG(F("handleClient: New Client"));
+    bool served = false;
 
-    _currentClient = client;
-    _currentStatus = HC_WAIT_READ;
-    _statusChange = millis();
+    for (uint8_t i = 0; i < ETHERNET_WEBSERVER_MAX_CLIENTS; i++)
+    {
+      if ( (_connections[i].status != HCS_FREE) && (_connections[i].client == client) )
+      {
+        served = true;
+        break;
+      }
+    }
+
+    if (served)
+    {
+      continue;
+    }
+
+    ET_LOGDEBUG1(F("handleClient: New Client in slot"), freeSlot);
+
+    ethernetHTTPConnection& conn = _connections[freeSlot];
+
+    conn.client       = client;
+    conn.status       = HCS_WAIT_READ;
+    conn.statusChange = millis();
+    conn.rxPos        = 0;
+    conn.rxLen        = 0;
+    conn.requestCount = 0;
+
+    _resetParser(conn);
   }
+}
 
-  bool keepCurrentClient = false;
-  bool callYield = false;
+////////////////////////////////////////
+
+// Advance the state machine of one connection slot. Returns true if the slot is idle-waiting on the client
+bool EthernetWebServer::_handleConnection(ethernetHTTPConnection& conn)
+{
+  bool keepClient = false;
+  bool callYield  = false;
+
+  _currentClient = conn.client;
 
-  if (_currentClient.connected() || _currentClient.available())
+  if (_currentClient.connected() || _currentClient.available() || (conn.rxPos < conn.rxLen))
   {
-    switch (_currentStatus)
+    switch (conn.status)
     {
-      case HC_NONE:
+      case HCS_FREE:
+      case HCS_HANDLE:
         // No-op to avoid C++ compiler warning
         break;
 
-      case HC_WAIT_READ:
+      case HCS_WAIT_READ:
 
-        // Wait for data from client to become available
-        if (_currentClient.available())
+        // Feed whatever has arrived to the parser, the request may come in several packets
+        switch (_parseRequest(conn))
         {
-          if (_parseRequest(_currentClient))
-          {
+          case HPS_DONE:
+
+            conn.status = HCS_HANDLE;
+
             _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
-            _contentLength = CONTENT_LENGTH_NOT_SET;
-            _handleRequest();
+            _contentLength      = CONTENT_LENGTH_NOT_SET;
+            _currentConnection  = &conn;
+
+            if (_setupRequest(conn))
+            {
+              _handleRequest();
+
+              if (_bodyRemaining)
+              {
+                // Drop the part of a streamed body the handler didn't read, the next request follows it
+                uint8_t skipBuf[32];
+
+                while (readBody(skipBuf, sizeof(skipBuf)))
+                  ;
+
+                if (_bodyRemaining)
+                  _keepAlive = false;
+              }
+
+              if (_keepAlive && _currentClient.connected())
+              {
+                // Persistent connection, wait for the next request on the same socket
+                conn.status       = HCS_WAIT_READ;
+                conn.statusChange = millis();
+                conn.requestCount++;
+                keepClient        = true;
+
+                _resetParser(conn);
+              }
 
 #if EWS_USE_CHROME_CONNECTION_FIX
 
-            // Fix for issue with Chrome based browsers: https://github.com/espressif/arduino-esp32/issues/3652
-            if (_currentClient.connected())
+              else if (_currentClient.connected())
+              {
+                // Fix for issue with Chrome based browsers: https://github.com/espressif/arduino-esp32/issues/3652
+                conn.status       = HCS_WAIT_CLOSE;
+                conn.statusChange = millis();
+                keepClient        = true;
+              }
+
+#endif
+            }
+
+            break;
+
+          case HPS_ERROR:
+
+            if (conn.parseError)
             {
-              _currentStatus = HC_WAIT_CLOSE;
-              _statusChange = millis();
-              keepCurrentClient = true;
+              // Nothing left over from the previous response on this connection
+              _currentVersion     = conn.version;
+              _keepAlive          = false;
+              _contentLength      = CONTENT_LENGTH_NOT_SET;
+              _acceptEncoding     = 0;
+              _chunked            = false;
+              _compressing        = false;
+              _responseHeadersLen = 0;
+
+              send(conn.parseError);
             }
 
-#endif
-          }
-        }
-        else
-        {
-          // !_currentClient.available()
-          if (millis() - _statusChange <= HTTP_MAX_DATA_WAIT)
-          {
-            keepCurrentClient = true;
-          }
+            break;
+
+          default:
+
+            // Incomplete request, wait for more data
+            unsigned long maxWait = HTTP_MAX_DATA_WAIT;
+
+            if (conn.parseState == HPS_BODY)
+            {
+              maxWait = HTTP_MAX_POST_WAIT;
+            }
+            else if (conn.requestCount && (conn.parseState == HPS_METHOD) && !conn.bufLen)
+            {
+              // Idle persistent connection
+              maxWait = HTTP_KEEPALIVE_TIMEOUT;
+            }
+
+            if (millis() - conn.statusChange <= maxWait)
+            {
+              keepClient = true;
+            }
 
-          callYield = true;
+            callYield = true;
+
+            break;
         }
 
         break;
 
-      case HC_WAIT_CLOSE:
+      case HCS_WAIT_CLOSE:
 
         // Wait for client to close the connection
-        if (millis() - _statusChange <= HTTP_MAX_CLOSE_WAIT)
+        if (millis() - conn.statusChange <= HTTP_MAX_CLOSE_WAIT)
         {
-          keepCurrentClient = true;
-          callYield = true;
+          keepClient = true;
+          callYield  = true;
         }
+
+        break;
     }
   }
 
-  if (!keepCurrentClient)
-  {
-    ET_LOGDEBUG(F("handleClient: Don't keepCurrentClient"));
-    _currentClient = EthernetClient();
-    _currentStatus = HC_NONE;
-    // KH
-    //_currentUpload.reset();
-  }
+  _flushResponse();
 
-  if (callYield)
+  _currentClient     = EthernetClient();
+  _keepAlive         = false;
+  _currentHeaderBuf  = nullptr;
+  _currentConnection = nullptr;
+  _bodyRemaining     = 0;
+  _plainLoaded       = false;
+
+  if (!keepClient)
   {
-    yield();
+    ET_LOGDEBUG(F("handleClient: Client disconnected"));
+
+    // KH, fix bug. Have to close the connection
+    _releaseConnection(conn);
   }
 
-  // KH, fix bug. Have to close the connection
-  _currentClient.stop();
-  //ET_LOGDEBUG(F("handleClient: Client disconnected"));
+  return callYield;
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_releaseConnection(ethernetHTTPConnection& conn)
+{
+  conn.client.stop();
+  conn.client = EthernetClient();
+  conn.status = HCS_FREE;
 }
 
 ////////////////////////////////////////
@@ -467,6 +760,16 @@ void EthernetWebServer::close()
   // KH, New v2.3.0
   _currentStatus = HC_NONE;
 
+#if USE_NEW_WEBSERVER_VERSION
+
+  for (uint8_t i = 0; i < ETHERNET_WEBSERVER_MAX_CLIENTS; i++)
+  {
+    if (_connections[i].status != HCS_FREE)
+      _releaseConnection(_connections[i]);
+  }
+
+#endif
+
   if (!_headerKeysCount)
     collectHeaders(0, 0);
 
@@ -484,20 +787,43 @@ void EthernetWebServer::stop()
 
 void EthernetWebServer::sendHeader(const String& name, const String& value, bool first)
 {
-  EWString headerLine = fromString(name);
+  sendHeader(name.c_str(), value.c_str(), first);
+}
+
+////////////////////////////////////////
 
-  headerLine += ": ";
-  headerLine += fromString(value);
-  headerLine += RETURN_NEWLINE;
+// Append "name: value\r\n" to the response headers, or insert it before them if first
+void EthernetWebServer::sendHeader(const char* name, const char* value, bool first)
+{
+  size_t nameLen  = strlen(name);
+  size_t valueLen = strlen(value);
+  size_t len      = nameLen + valueLen + 4;
 
-  if (first)
+  if (_responseHeadersLen + len > HTTP_HEADER_BUFLEN)
   {
-    _responseHeaders = fromEWString(headerLine + fromString(_responseHeaders));
+    ET_LOGERROR1(F("sendHeader: No room in HTTP_HEADER_BUFLEN for"), name);
+
+    return;
   }
-  else
+
+  char* line = _responseHeaders + _responseHeadersLen;
+
+  if (first)
   {
-    _responseHeaders = fromEWString(fromString(_responseHeaders) + headerLine);
+    memmove(_responseHeaders + len, _responseHeaders, _responseHeadersLen);
+    line = _responseHeaders;
   }
+
+  memcpy(line, name, nameLen);
+  line += nameLen;
+  *line++ = ':';
+  *line++ = ' ';
+  memcpy(line, value, valueLen);
+  line += valueLen;
+  *line++ = '\r';
+  *line   = '\n';
+
+  _responseHeadersLen += len;
 }
 
 ////////////////////////////////////////
@@ -509,125 +835,277 @@ void EthernetWebServer::setContentLength(size_t contentLength)
 
 ////////////////////////////////////////
 
-void EthernetWebServer::_prepareHeader(String& response, int code, const char* content_type, size_t contentLength)
+int EthernetWebServer::setContentRange(size_t size, size_t& start, size_t& length)
 {
-  EWString aResponse = fromString(response);
-
-  aResponse = "HTTP/1." + fromString(String(_currentVersion)) + " ";
-  aResponse += fromString(String(code));
-  aResponse += " ";
-  aResponse += fromString(_responseCodeToString(code));
-  aResponse += RETURN_NEWLINE;
+  start   = 0;
+  length  = size;
 
-  ET_LOGDEBUG1(F("_prepareHeader aResponse ="), fromEWString(aResponse));
+  sendHeader("Accept-Ranges", "bytes");
+  setContentLength(size);
 
-  using namespace mime;
+  if ( (_rangeFirst == HTTP_RANGE_NONE) && (_rangeLast == HTTP_RANGE_NONE) )
+    return 200;
 
-  if (!content_type)
-    content_type = mimeTable[html].mimeType;
+  if ( _ifRange && !_ifRangeMatches() )
+    return 200;
 
-  sendHeader("Content-Type", content_type, true);
+  size_t first = _rangeFirst;
+  size_t last  = ( (_rangeLast == HTTP_RANGE_NONE) || (_rangeLast >= size) ) ? size - 1 : _rangeLast;
 
-  if (_contentLength == CONTENT_LENGTH_NOT_SET)
-  {
-    sendHeader("Content-Length", String(contentLength));
-  }
-  else if (_contentLength != CONTENT_LENGTH_UNKNOWN)
-  {
-    sendHeader("Content-Length", String(_contentLength));
-  }
-  else if (_contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion)
+  if (_rangeFirst == HTTP_RANGE_NONE)
   {
-    //HTTP/1.1 or above client
-    //let's do chunked
-    _chunked = true;
-    sendHeader("Accept-Ranges", "none");
-    sendHeader("Transfer-Encoding", "chunked");
+    // Suffix, the last _rangeLast bytes
+    first = (_rangeLast >= size) ? 0 : size - _rangeLast;
+    last  = size - 1;
+
+    if (_rangeLast == 0)
+      first = size;
   }
 
-  if (_corsEnabled)
+  char contentRange[40];
+
+  if (first >= size)
   {
-    sendHeader("Access-Control-Allow-Origin",  "*");
-    sendHeader("Access-Control-Allow-Methods", "*");
-    sendHeader("Access-Control-Allow-Headers", "*");
-  }
+    snprintf(contentRange, sizeof(contentRange), "bytes */%lu", (unsigned long) size);
+    sendHeader("Content-Range", contentRange);
 
-  ET_LOGDEBUG(F("_prepareHeader sendHeader Conn close"));
+    length = 0;
+    setContentLength(0);
 
-  sendHeader("Connection", "close");
+    return 416;
+  }
 
-  aResponse += fromString(_responseHeaders);
-  aResponse += RETURN_NEWLINE;
+  snprintf(contentRange, sizeof(contentRange), "bytes %lu-%lu/%lu", (unsigned long) first, (unsigned long) last,
+           (unsigned long) size);
+  sendHeader("Content-Range", contentRange);
 
-  response = fromEWString(aResponse);
+  start   = first;
+  length  = last - first + 1;
+  setContentLength(length);
 
-  _responseHeaders = String("");
+  return 206;
 }
 
 ////////////////////////////////////////
 
-#if ! ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
-void EthernetWebServer::_prepareHeader(EWString& response, int code, const char* content_type, size_t contentLength)
+// The If-Range validator of the request is the ETag, or else the Last-Modified date, of the response.
+// A weak ETag ("W/...") is taken for a date and never matches, as RFC 9110 requires
+bool EthernetWebServer::_ifRangeMatches()
 {
-  response = "HTTP/1." + fromString(String(_currentVersion)) + " ";
-  response += fromString(String(code));
-  response += " ";
-  response += fromString(_responseCodeToString(code));
-  response += RETURN_NEWLINE;
+  bool        isETag = (_ifRange[0] == '"');
+  const char* name   = isETag ? "ETag: " : "Last-Modified: ";
+  size_t      len    = strlen(name);
+  size_t      pos    = 0;
+
+  while (pos < _responseHeadersLen)
+  {
+    const char* line = _responseHeaders + pos;
+    const char* eol  = (const char*) memchr(line, '\r', _responseHeadersLen - pos);
+
+    if (!eol)
+      break;
 
-  //ET_LOGDEBUG1(F("_prepareHeader response ="), fromEWString(response));
+    if ( ((size_t) (eol - line) > len) && !strncasecmp(line, name, len) )
+    {
+      size_t valueLen = eol - line - len;
+
+      return (strlen(_ifRange) == valueLen) && !memcmp(_ifRange, line + len, valueLen);
+    }
+
+    pos = eol - _responseHeaders + 2;
+  }
+
+  return false;
+}
 
+////////////////////////////////////////
+
+// Write the status line and headers of the response, straight into the TX buffer
+void EthernetWebServer::_prepareHeader(int code, const char* content_type, size_t contentLength)
+{
   using namespace mime;
 
   if (!content_type)
-    content_type = mimeTable[html].mimeType;
+    content_type = mime::contentType(html);
+
+  _writeP(F("HTTP/1."));
+  _writeNumber(_currentVersion);
+  _write(" ", 1);
+  _writeNumber(code);
+  _write(" ", 1);
+  _writeP(_responseCodeReason(code));
+  _write(RETURN_NEWLINE, 2);
 
-  sendHeader("Content-Type", content_type, true);
+  _writeHeader(F("Content-Type"), content_type);
 
   if (_contentLength == CONTENT_LENGTH_NOT_SET)
   {
-    sendHeader("Content-Length", String(contentLength));
+    _writeHeader(F("Content-Length"), contentLength);
   }
   else if (_contentLength != CONTENT_LENGTH_UNKNOWN)
   {
-    sendHeader("Content-Length", String(_contentLength));
+    _writeHeader(F("Content-Length"), _contentLength);
   }
   else if (_contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion)
   {
     //HTTP/1.1 or above client
     //let's do chunked
     _chunked = true;
-    sendHeader("Accept-Ranges", "none");
-    sendHeader("Transfer-Encoding", "chunked");
+    _writeHeader(F("Accept-Ranges"), F("none"));
+    _writeHeader(F("Transfer-Encoding"), F("chunked"));
+  }
+
+  if (_contentLength == CONTENT_LENGTH_UNKNOWN && !_currentVersion)
+  {
+    // HTTP/1.0 client, the end of the response is only marked by closing the connection
+    _keepAlive = false;
+  }
+
+#if (HTTP_DEFLATE_WINDOW > 0)
+
+  _compressing = _compressionEnabled && (_contentLength == CONTENT_LENGTH_UNKNOWN)
+                 && (_acceptEncoding & (HTTP_ENCODING_GZIP | HTTP_ENCODING_DEFLATE));
+
+  if (_compressing)
+  {
+    if (!_deflate)
+      _deflate = new ethernetDeflate(*this);
+
+    bool gzip = _acceptEncoding & HTTP_ENCODING_GZIP;
+
+    _writeHeader(F("Content-Encoding"), gzip ? F("gzip") : F("deflate"));
+    _writeHeader(F("Vary"), F("Accept-Encoding"));
   }
 
+#endif
+
+  _writeConnectionHeaders();
+
+  _write(_responseHeaders, _responseHeadersLen);
+  _write(RETURN_NEWLINE, 2);
+
+  _responseHeadersLen = 0;
+
+#if (HTTP_DEFLATE_WINDOW > 0)
+
+  if (_compressing)
+    _deflate->begin(_acceptEncoding & HTTP_ENCODING_GZIP);
+
+#endif
+}
+
+////////////////////////////////////////
+
+// Headers that depend on the server settings and the connection rather than on the response
+void EthernetWebServer::_writeConnectionHeaders()
+{
   if (_corsEnabled)
   {
-    sendHeader("Access-Control-Allow-Origin",  "*");
-    sendHeader("Access-Control-Allow-Methods", "*");
-    sendHeader("Access-Control-Allow-Headers", "*");
+    _writeHeader(F("Access-Control-Allow-Origin"),  F("*"));
+    _writeHeader(F("Access-Control-Allow-Methods"), F("*"));
+    _writeHeader(F("Access-Control-Allow-Headers"), F("*"));
+  }
+
+  if (_keepAlive)
+  {
+    ET_LOGDEBUG(F("_prepareHeader sendHeader Conn keep-alive"));
+
+    _writeHeader(F("Connection"), F("keep-alive"));
+    _writeP(F("Keep-Alive: timeout="));
+    _writeNumber(HTTP_KEEPALIVE_TIMEOUT / 1000);
+    _write(RETURN_NEWLINE, 2);
+  }
+  else
+  {
+    ET_LOGDEBUG(F("_prepareHeader sendHeader Conn close"));
+
+    _writeHeader(F("Connection"), F("close"));
   }
+}
 
-  ET_LOGDEBUG(F("_prepareHeader sendHeader Conn close"));
+////////////////////////////////////////
 
-  sendHeader("Connection", "close");
+// Output of the compressor, one chunk per piece
+void EthernetWebServer::_sendCompressed(const uint8_t* data, size_t len)
+{
+  if (_chunked)
+    _writeChunkSize(len);
 
-  response += fromString(_responseHeaders);
-  response += RETURN_NEWLINE;
+  _write(data, len);
 
-  _responseHeaders = String("");
+  if (_chunked)
+    _write(RETURN_NEWLINE, 2);
 }
-#endif
 
 ////////////////////////////////////////
 
-void EthernetWebServer::send(int code, const char* content_type, const String& content)
+// Replay a response serialized by onStatic(). head starts after "HTTP/1.x" and ends before the connection headers
+void EthernetWebServer::_sendCached(const char* head, size_t headLen, PGM_P content, size_t contentLength, bool contentInFlash)
+{
+  _writeP(F("HTTP/1."));
+  _writeNumber(_currentVersion);
+  _write(head, headLen);
+  _writeConnectionHeaders();
+  _write(RETURN_NEWLINE, 2);
+
+  if (contentInFlash)
+    _write_P(content, contentLength);
+  else
+    _write(content, contentLength);
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_writeHeader(const __FlashStringHelper* name, const char* value)
+{
+  _writeP(name);
+  _write(": ", 2);
+  _write(value, strlen(value));
+  _write(RETURN_NEWLINE, 2);
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_writeHeader(const __FlashStringHelper* name, const __FlashStringHelper* value)
+{
+  _writeP(name);
+  _write(": ", 2);
+  _writeP(value);
+  _write(RETURN_NEWLINE, 2);
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_writeHeader(const __FlashStringHelper* name, size_t value)
+{
+  _writeP(name);
+  _write(": ", 2);
+  _writeNumber(value);
+  _write(RETURN_NEWLINE, 2);
+}
+
+////////////////////////////////////////
+
+// Decimal digits of value, without a String or sprintf()
+void EthernetWebServer::_writeNumber(size_t value)
 {
-  EWString header;
+  char    digits[20];
+  uint8_t pos = sizeof(digits);
 
-  _prepareHeader(header, code, content_type, content.length());
+  do
+  {
+    digits[--pos] = '0' + (value % 10);
+    value /= 10;
+  } while (value);
+
+  _write(digits + pos, sizeof(digits) - pos);
+}
+
+////////////////////////////////////////
 
-  _currentClient.write((const uint8_t *)header.c_str(), header.length());
+void EthernetWebServer::send(int code, const char* content_type, const String& content)
+{
+  _prepareHeader(code, content_type, content.length());
 
   if (content.length())
   {
@@ -639,14 +1117,10 @@ void EthernetWebServer::send(int code, const char* content_type, const String& c
 
 void EthernetWebServer::send(int code, char* content_type, const String& content, size_t contentLength)
 {
-  EWString header;
-
   char type[64];
 
   memccpy((void*)type, content_type, 0, sizeof(type));
-  _prepareHeader(header, code, (const char* )type, contentLength);
-
-  _currentClient.write((const uint8_t *) header.c_str(), header.length());
+  _prepareHeader(code, (const char* )type, contentLength);
 
   if (contentLength)
   {
@@ -681,11 +1155,7 @@ void EthernetWebServer::send(int code, const char* content_type, const char* con
 
 void EthernetWebServer::send(int code, const char* content_type, const char* content, size_t contentLength)
 {
-  String header;
-
-  _prepareHeader(header, code, content_type, contentLength);
-
-  _currentClient.write((const uint8_t *) header.c_str(), header.length());
+  _prepareHeader(code, content_type, contentLength);
 
   if (contentLength)
   {
@@ -697,23 +1167,36 @@ void EthernetWebServer::send(int code, const char* content_type, const char* con
 
 void EthernetWebServer::sendContent(const char* content, size_t contentLength)
 {
-  const char * footer = RETURN_NEWLINE;
+#if (HTTP_DEFLATE_WINDOW > 0)
 
-  if (_chunked)
+  if (_compressing)
   {
-    char chunkSize[11];
+    if (contentLength)
+    {
+      _deflate->write((const uint8_t*) content, contentLength);
+
+      return;
+    }
 
+    // End of the response, the compressor hands over its last chunks before the empty one
+    _deflate->finish();
+    _compressing = false;
+  }
+
+#endif
+
+  if (_chunked)
+  {
     ET_LOGDEBUG1(F("sendContent_char: _chunked, _currentVersion ="), _currentVersion);
 
-    sprintf(chunkSize, "%x%s", contentLength, footer);
-    _currentClient.write(chunkSize, strlen(chunkSize));
+    _writeChunkSize(contentLength);
   }
 
-  _currentClient.write(content, contentLength);
+  _write(content, contentLength);
 
   if (_chunked)
   {
-    _currentClient.write(footer, 2);
+    _write(RETURN_NEWLINE, 2);
 
     if (contentLength == 0)
     {
@@ -748,18 +1231,13 @@ void EthernetWebServer::send_P(int code, PGM_P content_type, PGM_P content)
     contentLength = strlen_P(content);
   }
 
-  String header;
   char type[64];
 
   memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
-  _prepareHeader(header, code, (const char* )type, contentLength);
+  _prepareHeader(code, (const char* )type, contentLength);
 
   ET_LOGDEBUG1(F("send_P: len = "), contentLength);
   ET_LOGDEBUG1(F("content = "), content);
-  ET_LOGDEBUG1(F("send_P: hdrlen = "), header.length());
-  ET_LOGDEBUG1(F("header = "), header);
-
-  _currentClient.write(header.c_str(), header.length());
 
   if (contentLength)
   {
@@ -771,19 +1249,13 @@ void EthernetWebServer::send_P(int code, PGM_P content_type, PGM_P content)
 
 void EthernetWebServer::send_P(int code, PGM_P content_type, PGM_P content, size_t contentLength)
 {
-  EWString header;
-
   char type[64];
 
   memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
-  _prepareHeader(header, code, (const char* )type, contentLength);
+  _prepareHeader(code, (const char* )type, contentLength);
 
   ET_LOGDEBUG1(F("send_P: len = "), contentLength);
   ET_LOGDEBUG1(F("content = "), content);
-  ET_LOGDEBUG1(F("send_P: hdrlen = "), header.length());
-  ET_LOGDEBUG1(F("header = "), fromEWString(header));
-
-  _currentClient.write((const uint8_t *) header.c_str(), header.length());
 
   if (contentLength)
   {
@@ -802,50 +1274,50 @@ void EthernetWebServer::sendContent_P(PGM_P content)
 
 void EthernetWebServer::sendContent_P(PGM_P content, size_t contentLength)
 {
-  const char * footer = RETURN_NEWLINE;
+#if (HTTP_DEFLATE_WINDOW > 0)
 
-  if (_chunked)
+  if (_compressing && contentLength)
   {
-    char chunkSize[11];
-
-    ET_LOGDEBUG1(F("sendContent_P: _chunked, _currentVersion ="), _currentVersion);
+#if EWS_FLASH_IS_MEMORY_MAPPED
+    _deflate->write((const uint8_t*) content, contentLength);
+#else
+    uint8_t chunk[32];
 
-    sprintf(chunkSize, "%x%s", contentLength, footer);
-    _currentClient.write(chunkSize, strlen(chunkSize));
-  }
+    while (contentLength)
+    {
+      size_t part = (contentLength < sizeof(chunk)) ? contentLength : sizeof(chunk);
 
-  uint8_t* _sendContentBuffer = new uint8_t[SENDCONTENT_P_BUFFER_SZ];
+      memcpy_P(chunk, content, part);
+      _deflate->write(chunk, part);
 
-  if (_sendContentBuffer)
-  {
-    uint16_t count = contentLength / SENDCONTENT_P_BUFFER_SZ;
-    uint16_t remainder = contentLength % SENDCONTENT_P_BUFFER_SZ;
-    uint16_t i = 0;
-
-    for (i = 0; i < count; i++)
-    {
-      /* code */
-      memcpy_P(_sendContentBuffer, &content[i * SENDCONTENT_P_BUFFER_SZ], SENDCONTENT_P_BUFFER_SZ);
-      _currentClient.write(_sendContentBuffer, SENDCONTENT_P_BUFFER_SZ);
+      content       += part;
+      contentLength -= part;
     }
+#endif
 
-    memcpy_P(_sendContentBuffer, &content[i * SENDCONTENT_P_BUFFER_SZ], remainder);
-    _currentClient.write(_sendContentBuffer, remainder);
-
-    delete [] _sendContentBuffer;
+    return;
   }
-  else
+
+#endif
+
+  if (_chunked)
   {
-    ET_LOGERROR1(F("sendContent_P: Error, can't allocate _sendContentBuffer, Sz ="), SENDCONTENT_P_BUFFER_SZ);
+    ET_LOGDEBUG1(F("sendContent_P: _chunked, _currentVersion ="), _currentVersion);
 
-    return;
+    _writeChunkSize(contentLength);
   }
 
+  // Copied from flash straight into the TX buffer, so consecutive fragments share its packets
+  _write_P(content, contentLength);
+
   if (_chunked)
   {
-    _currentClient.write(footer, 2);
+    _write(RETURN_NEWLINE, 2);
 
-    _chunked = false;
+    if (contentLength == 0)
+    {
+      _chunked = false;
+    }
   }
 }
 
@@ -859,26 +1331,48 @@ void EthernetWebServer::sendContent_P(PGM_P content, size_t contentLength)
 
 void EthernetWebServer::serveStatic(const char* uri, FS& fs, const char* path, const char* cache_header)
 {
-  _addRequestHandler(new StaticFileRequestHandler(fs, path, uri, cache_header));
+  File file         = fs.open(path, "r");
+  bool isDirectory  = String(path).endsWith("/") || (file && file.isDirectory());
+
+  file.close();
+
+  if (isDirectory)
+    _addRequestHandler(new StaticDirectoryRequestHandler(fs, path, uri, cache_header));
+  else
+    _addRequestHandler(new StaticFileRequestHandler(fs, path, uri, cache_header));
 }
 
 ////////////////////////////////////////
 
-void EthernetWebServer::_streamFileCore(const size_t fileSize, const String &fileName, const String &contentType,
-                                        const int code)
+// Send the headers for streamFile(), returns how much of the file goes in the body, from start
+size_t EthernetWebServer::_streamFileCore(const size_t fileSize, const String &fileName, const String &contentType,
+                                          const int code, size_t& start)
 {
   using namespace mime;
 
-  setContentLength(fileSize);
+  int    status = code;
+  size_t length = fileSize;
 
-  if (fileName.endsWith(String(FPSTR(mimeTable[gz].endsWith))) &&
-      contentType != String(FPSTR(mimeTable[gz].mimeType)) &&
-      contentType != String(FPSTR(mimeTable[none].mimeType)))
+  start = 0;
+
+  if (code == 200)
+    status = setContentRange(fileSize, start, length);
+  else
+    setContentLength(fileSize);
+
+  if ( (getType(fileName.c_str()) == gz) && contentType != mime::contentType(gz) &&
+       contentType != mime::contentType(none) )
   {
     sendHeader(F("Content-Encoding"), F("gzip"));
   }
+  else if (fileName.endsWith(".br"))
+  {
+    sendHeader(F("Content-Encoding"), F("br"));
+  }
+
+  send(status, contentType, emptyString);
 
-  send(code, contentType, emptyString);
+  return length;
 }
 #endif
 
@@ -886,6 +1380,13 @@ void EthernetWebServer::_streamFileCore(const size_t fileSize, const String &fil
 
 String EthernetWebServer::arg(const String& name)
 {
+#if USE_NEW_WEBSERVER_VERSION
+
+  if ( _bodyRemaining && !_plainLoaded && (name == "plain") )
+    _readPlainBody();
+
+#endif
+
   for (int i = 0; i < _currentArgCount; ++i)
   {
     if ( _currentArgs[i].key == name )
@@ -897,6 +1398,16 @@ String EthernetWebServer::arg(const String& name)
 
 ////////////////////////////////////////
 
+String EthernetWebServer::pathArg(unsigned int i)
+{
+  if (i < _pathArgs.count)
+    return _currentUri.substring(_pathArgs.start[i], _pathArgs.start[i] + _pathArgs.length[i]);
+
+  return String();
+}
+
+////////////////////////////////////////
+
 String EthernetWebServer::arg(int i)
 {
   if (i < _currentArgCount)
@@ -926,6 +1437,13 @@ int EthernetWebServer::args()
 
 bool EthernetWebServer::hasArg(const String& name)
 {
+#if USE_NEW_WEBSERVER_VERSION
+
+  if ( _bodyRemaining && !_plainLoaded && (name == "plain") )
+    _readPlainBody();
+
+#endif
+
   for (int i = 0; i < _currentArgCount; ++i)
   {
     if (_currentArgs[i].key == name)
@@ -937,6 +1455,99 @@ bool EthernetWebServer::hasArg(const String& name)
 
 ////////////////////////////////////////
 
+#if USE_NEW_WEBSERVER_VERSION
+
+////////////////////////////////////////
+
+String EthernetWebServer::header(const String& name)
+{
+  size_t length;
+  const char* value = header(name.c_str(), length);
+
+  return value ? String(value) : String();
+}
+
+////////////////////////////////////////
+
+const char* EthernetWebServer::header(const char* name, size_t& length)
+{
+  int i = _findHeader(name);
+
+  length = 0;
+
+  if ( (i < 0) || !_currentHeaderBuf || !_headerSlices[i].length )
+    return nullptr;
+
+  length = _headerSlices[i].length;
+
+  return _currentHeaderBuf + _headerSlices[i].start;
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::collectHeaders(const char* headerKeys[], const size_t headerKeysCount)
+{
+  _headerKeysCount = headerKeysCount + 1;
+
+  if (_currentHeaders)
+    delete[]_currentHeaders;
+
+  if (_headerSlices)
+    delete[] _headerSlices;
+
+  _currentHeaders = new RequestArgument[_headerKeysCount];
+  _headerSlices   = new ethernetHeaderSlice[_headerKeysCount];
+
+  for (int i = 0; i < _headerKeysCount; i++)
+  {
+    _currentHeaders[i].key  = (i == 0) ? ETHERNET_AUTHORIZATION_HEADER : headerKeys[i - 1];
+    _headerSlices[i].hash   = _headerHash(_currentHeaders[i].key.c_str());
+    _headerSlices[i].length = 0;
+  }
+}
+
+////////////////////////////////////////
+
+String EthernetWebServer::header(int i)
+{
+  if ( (i < _headerKeysCount) && _currentHeaderBuf && _headerSlices[i].length )
+    return String(_currentHeaderBuf + _headerSlices[i].start);
+
+  return String();
+}
+
+////////////////////////////////////////
+
+String EthernetWebServer::headerName(int i)
+{
+  if (i < _headerKeysCount)
+    return _currentHeaders[i].key;
+
+  return String();
+}
+
+////////////////////////////////////////
+
+int EthernetWebServer::headers()
+{
+  return _headerKeysCount;
+}
+
+////////////////////////////////////////
+
+bool EthernetWebServer::hasHeader(const String& name)
+{
+  size_t length;
+
+  return header(name.c_str(), length) != nullptr;
+}
+
+////////////////////////////////////////
+
+#else   // #if USE_NEW_WEBSERVER_VERSION
+
+////////////////////////////////////////
+
 String EthernetWebServer::header(const String& name)
 {
   for (int i = 0; i < _headerKeysCount; ++i)
@@ -1008,6 +1619,10 @@ bool EthernetWebServer::hasHeader(const String& name)
 
 ////////////////////////////////////////
 
+#endif    // #if USE_NEW_WEBSERVER_VERSION
+
+////////////////////////////////////////
+
 String EthernetWebServer::hostHeader()
 {
   return _hostHeader;
@@ -1063,7 +1678,7 @@ void EthernetWebServer::_handleRequest()
   {
     using namespace mime;
 
-    send(404, mimeTable[html].mimeType, String("Not found: ") + _currentUri);
+    send(404, mime::contentType(html), String("Not found: ") + _currentUri);
     handled = true;
   }
 
@@ -1077,7 +1692,7 @@ void EthernetWebServer::_handleRequest()
   //_currentUri = String();
   ET_LOGDEBUG(F("_handleRequest: Done Clear _currentUri"));
 #else
-  _responseHeaders = String("");
+  _responseHeadersLen = 0;
 #endif
 }
 
@@ -1085,15 +1700,149 @@ void EthernetWebServer::_handleRequest()
 
 void EthernetWebServer::_finalizeResponse()
 {
-  if (_chunked)
+  if (_chunked || _compressing)
   {
     sendContent(String());
   }
+
+  _flushResponse();
+}
+
+////////////////////////////////////////
+
+size_t EthernetWebServer::_write(const void* data, size_t len)
+{
+#if (HTTP_TX_BUFLEN > 0)
+  const uint8_t* src = (const uint8_t*) data;
+  size_t size = len;
+
+  while (size)
+  {
+    if ( !_txLen && (size >= HTTP_TX_BUFLEN) )
+    {
+      // Nothing buffered and a full buffer worth to send, skip the copy
+      return _currentClient.write(src, size) + (len - size);
+    }
+
+    size_t part = HTTP_TX_BUFLEN - _txLen;
+
+    if (part > size)
+      part = size;
+
+    memcpy(_txBuf + _txLen, src, part);
+
+    _txLen += part;
+    src    += part;
+    size   -= part;
+
+    if (_txLen == HTTP_TX_BUFLEN)
+      _flushResponse();
+  }
+
+  return len;
+#else
+  return _currentClient.write((const uint8_t*) data, len);
+#endif
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_flushResponse()
+{
+#if (HTTP_TX_BUFLEN > 0)
+
+  if (_txLen)
+  {
+    _currentClient.write(_txBuf, _txLen);
+    _txLen = 0;
+  }
+
+#endif
+}
+
+////////////////////////////////////////
+
+// "<hex size>\r\n" line starting a chunk
+void EthernetWebServer::_writeChunkSize(size_t size)
+{
+  char    digits[18];
+  uint8_t pos = sizeof(digits);
+
+  digits[--pos] = '\n';
+  digits[--pos] = '\r';
+
+  do
+  {
+    digits[--pos] = "0123456789abcdef"[size & 0x0F];
+    size >>= 4;
+  } while (size);
+
+  _write(digits + pos, sizeof(digits) - pos);
+}
+
+////////////////////////////////////////
+
+// _write() of len bytes from flash
+void EthernetWebServer::_write_P(PGM_P data, size_t len)
+{
+#if EWS_FLASH_IS_MEMORY_MAPPED
+
+  // PROGMEM data is in the normal address space, no need to copy it out first
+  _write(data, len);
+
+#elif (HTTP_TX_BUFLEN > 0)
+
+  while (len)
+  {
+    size_t part = HTTP_TX_BUFLEN - _txLen;
+
+    if (part > len)
+      part = len;
+
+    memcpy_P(_txBuf + _txLen, data, part);
+
+    _txLen += part;
+    data   += part;
+    len    -= part;
+
+    if (_txLen == HTTP_TX_BUFLEN)
+      _flushResponse();
+  }
+
+#else
+  uint8_t chunk[32];
+
+  while (len)
+  {
+    size_t part = (len < sizeof(chunk)) ? len : sizeof(chunk);
+
+    memcpy_P(chunk, data, part);
+    _currentClient.write(chunk, part);
+
+    data += part;
+    len  -= part;
+  }
+
+#endif
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_writeP(const __FlashStringHelper* text)
+{
+  _write_P((PGM_P) text, strlen_P((PGM_P) text));
 }
 
 ////////////////////////////////////////
 
 String EthernetWebServer::_responseCodeToString(int code)
+{
+  return String(_responseCodeReason(code));
+}
+
+////////////////////////////////////////
+
+const __FlashStringHelper* EthernetWebServer::_responseCodeReason(int code)
 {
   switch (code)
   {
@@ -1199,6 +1948,9 @@ String EthernetWebServer::_responseCodeToString(int code)
     case 417:
       return F("Expectation Failed");
 
+    case 431:
+      return F("Request Header Fields Too Large");
+
     case 500:
       return F("Internal Server Error");
 
@@ -1218,7 +1970,7 @@ String EthernetWebServer::_responseCodeToString(int code)
       return F("HTTP Version not supported");
 
     default:
-      return "";
+      return F("");
   }
 }
 
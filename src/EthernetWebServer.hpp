@@ -197,8 +197,6 @@
 
 /////////////////////////////////////////////////////////////////////////
 
-#include "detail/mimetable.h"
-
 // KH, For PROGMEM commands
 // ESP32/ESP8266 includes <pgmspace.h> by default, and memccpy_P was already defined there
 #if !( defined(ESP32) || defined(ESP8266) )
@@ -208,24 +206,18 @@
 
 /////////////////////////////////////////////////////////////////////////
 
-// Permit redefinition of SENDCONTENT_P_BUFFER_SZ in sketch, default is 4K, minimum is 256 bytes
-#ifndef SENDCONTENT_P_BUFFER_SZ
-  #define SENDCONTENT_P_BUFFER_SZ     4096
-  
-  #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
-  	#warning SENDCONTENT_P_BUFFER_SZ using default 4 Kbytes
-  #endif
-#else
-  #if (SENDCONTENT_P_BUFFER_SZ < 256)
-    #undef SENDCONTENT_P_BUFFER_SZ
-    #define SENDCONTENT_P_BUFFER_SZ   256
-    
-    #if (_ETHERNET_WEBSERVER_LOGLEVEL_ > 3)
-    	#warning SENDCONTENT_P_BUFFER_SZ reset to min 256 bytes
-    #endif
+// Flash can be read like RAM everywhere except AVR, whose flash is a separate address space,
+// and ESP8266, whose flash only allows aligned 32-bit reads
+#if !defined(EWS_FLASH_IS_MEMORY_MAPPED)
+  #if ( defined(__AVR__) || defined(ESP8266) )
+    #define EWS_FLASH_IS_MEMORY_MAPPED    false
+  #else
+    #define EWS_FLASH_IS_MEMORY_MAPPED    true
   #endif
 #endif
 
+#include "detail/mimetable.h"
+
 #ifndef PGM_VOID_P
   #define PGM_VOID_P const void *
 #endif
@@ -297,6 +289,130 @@
 
 /////////////////////////////////////////////////////////////////////////
 
+// Permit user to change the number of client connections serviced concurrently by handleClient()
+// Each one takes HTTP_REQUEST_BUFLEN + HTTP_RX_BUFLEN bytes and a few more of RAM, about 1.3 KB on
+// 32-bit boards and 340 bytes on AVR. Default is 3, 2 on AVR, and never more than the hardware sockets
+#if !defined(ETHERNET_WEBSERVER_MAX_CLIENTS)
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define ETHERNET_WEBSERVER_MAX_CLIENTS      2
+  #elif defined(MAX_SOCK_NUM) && (MAX_SOCK_NUM < 3)
+    #define ETHERNET_WEBSERVER_MAX_CLIENTS      MAX_SOCK_NUM
+  #else
+    #define ETHERNET_WEBSERVER_MAX_CLIENTS      3
+  #endif
+#elif (ETHERNET_WEBSERVER_MAX_CLIENTS < 1)
+  #undef ETHERNET_WEBSERVER_MAX_CLIENTS
+  #define ETHERNET_WEBSERVER_MAX_CLIENTS        1
+#endif
+
+// Permit user to tune HTTP/1.1 persistent connections
+// HTTP_KEEPALIVE_MAX_REQUESTS is the number of requests served on one connection before it is closed, 0 to disable keep-alive
+// HTTP_KEEPALIVE_TIMEOUT is the time (ms) an idle persistent connection keeps its socket waiting for the next request
+#if !defined(HTTP_KEEPALIVE_MAX_REQUESTS)
+  #define HTTP_KEEPALIVE_MAX_REQUESTS     100
+#endif
+
+#if !defined(HTTP_KEEPALIVE_TIMEOUT)
+  #define HTTP_KEEPALIVE_TIMEOUT          2000
+#endif
+
+// Permit user to change how many pipelined requests of one connection are answered in a single handleClient() call
+#if !defined(HTTP_PIPELINE_DEPTH)
+  #define HTTP_PIPELINE_DEPTH             8
+#endif
+
+// Permit user to change the max number of "{param}" captures of a route, see pathArg()
+#if !defined(HTTP_MAX_PATH_ARGS)
+  #define HTTP_MAX_PATH_ARGS              8
+#endif
+
+// Permit user to change the per-connection request buffers
+// HTTP_REQUEST_BUFLEN holds the request URI and the headers kept for the handler, a request whose kept
+// headers don't fit is answered 431
+// HTTP_RX_BUFLEN is the block size read from the socket at a time, at least 74 to hold any multipart boundary
+#if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+  #if !defined(HTTP_REQUEST_BUFLEN)
+    #define HTTP_REQUEST_BUFLEN     256
+  #endif
+
+  #if !defined(HTTP_RX_BUFLEN)
+    #define HTTP_RX_BUFLEN          80
+  #endif
+#else
+  #if !defined(HTTP_REQUEST_BUFLEN)
+    #define HTTP_REQUEST_BUFLEN     1024
+  #endif
+
+  #if !defined(HTTP_RX_BUFLEN)
+    #define HTTP_RX_BUFLEN          256
+  #endif
+#endif
+
+// Permit user to change the response buffer, which gathers the status line, headers, chunk framing and body
+// and writes them to the socket in as few packets as possible. Default is one TCP MSS, 0 to write unbuffered
+#if !defined(HTTP_TX_BUFLEN)
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_TX_BUFLEN          128
+  #else
+    #define HTTP_TX_BUFLEN          1460
+  #endif
+#endif
+
+// Permit user to change the room for the headers a handler adds with sendHeader()
+#if !defined(HTTP_HEADER_BUFLEN)
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_HEADER_BUFLEN      128
+  #else
+    #define HTTP_HEADER_BUFLEN      512
+  #endif
+#endif
+
+/////////////////////////////////////////////////////////////////////////
+
+// Permit user to change the compressor of enableCompression(), allocated on first use
+// HTTP_DEFLATE_WINDOW is the match history (512 to 4096 bytes), 0 leaves compression out. The compressor takes
+// twice this, plus 2 << HTTP_DEFLATE_HASH_BITS bytes of hash table and HTTP_DEFLATE_OUTBUF bytes of output,
+// about 3.5 KB at the defaults
+#if !defined(HTTP_DEFLATE_WINDOW)
+  #if ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+    #define HTTP_DEFLATE_WINDOW     0
+  #else
+    #define HTTP_DEFLATE_WINDOW     1024
+  #endif
+#elif ( (HTTP_DEFLATE_WINDOW > 0) && (HTTP_DEFLATE_WINDOW < 512) )
+  #undef HTTP_DEFLATE_WINDOW
+  #define HTTP_DEFLATE_WINDOW       512
+#elif (HTTP_DEFLATE_WINDOW > 4096)
+  #undef HTTP_DEFLATE_WINDOW
+  #define HTTP_DEFLATE_WINDOW       4096
+#endif
+
+#if !defined(HTTP_DEFLATE_HASH_BITS)
+  #define HTTP_DEFLATE_HASH_BITS    9
+#endif
+
+#if !defined(HTTP_DEFLATE_OUTBUF)
+  #define HTTP_DEFLATE_OUTBUF       512
+#endif
+
+// Permit user to change the ETags of serveStatic() files (ESP32/ESP8266), computed on first request
+// HTTP_ETAG_CACHE_SIZE is the number of files whose ETag is kept in RAM
+// Define HTTP_ETAG_CACHE_FILE, e.g. "/.etags", to keep computed ETags in that file of the served filesystem
+// across reboots. A stored ETag is only reused while the file keeps the same size
+#if !defined(HTTP_ETAG_CACHE_SIZE)
+  #define HTTP_ETAG_CACHE_SIZE      16
+#endif
+
+// Content codings of the Accept-Encoding request header, see acceptsEncoding()
+#define HTTP_ENCODING_GZIP      0x01
+#define HTTP_ENCODING_DEFLATE   0x02
+#define HTTP_ENCODING_BR        0x04
+
+// Byte left out of the "Range" request header, see setContentRange()
+#define HTTP_RANGE_NONE         ((uint32_t) -1)
+
+/////////////////////////////////////////////////////////////////////////
+
 #define CONTENT_LENGTH_UNKNOWN  ((size_t) -1)
 #define CONTENT_LENGTH_NOT_SET  ((size_t) -2)
 
@@ -329,8 +445,244 @@ typedef struct
   uint8_t buf[HTTP_UPLOAD_BUFLEN];
 } ethernetHTTPUpload;
 
+// "{param}" captures of the matched route, as offsets into the request URI
+typedef struct
+{
+  uint8_t   count;
+  uint16_t  start[HTTP_MAX_PATH_ARGS];
+  uint16_t  length[HTTP_MAX_PATH_ARGS];
+} ethernetPathArgs;
+
+// Value of a collected header, as a slice of the request buffer of the connection being served
+typedef struct
+{
+  uint32_t  hash;       // _headerHash() of the header name, computed by collectHeaders()
+  uint16_t  start;
+  uint16_t  length;     // 0 if the header is absent
+} ethernetHeaderSlice;
+
+// State of one client connection slot, serviced round-robin by handleClient()
+enum HTTPConnectionStatus
+{
+  HCS_FREE,           // slot not in use
+  HCS_WAIT_READ,      // waiting for the client to send the request
+  HCS_HANDLE,         // request parsed, being dispatched to its handler
+  HCS_WAIT_CLOSE      // response sent, waiting for the client to close the connection
+};
+
+// Position of the incremental request parser, kept per connection between handleClient() calls
+enum HTTPParserState
+{
+  HPS_METHOD,
+  HPS_URI,
+  HPS_VERSION,
+  HPS_HEADER_NAME,
+  HPS_HEADER_VALUE,
+  HPS_HEADER_SKIP,
+  HPS_BODY,
+  HPS_DONE,
+  HPS_ERROR
+};
+
+// Request flags collected from the headers
+#define HPF_FORM_ENCODED      0x01    // application/x-www-form-urlencoded body
+#define HPF_MULTIPART         0x02    // multipart/form-data body
+#define HPF_KEEP_HEADER       0x04    // header being parsed is stored in the request buffer
+#define HPF_CONN_CLOSE        0x08    // "Connection: close"
+#define HPF_CONN_KEEP_ALIVE   0x10    // "Connection: keep-alive"
+#define HPF_STREAM_BODY       0x20    // body left in the socket for readBody()
+#define HPF_CONTENT_LENGTH    0x40    // "Content-Length" seen
+#define HPF_TRANSFER_ENCODING 0x80    // "Transfer-Encoding" seen, the body isn't framed by Content-Length
+
+typedef struct
+{
+  EthernetClient        client;
+  HTTPConnectionStatus  status;
+  unsigned long         statusChange;
+
+  // Incremental request parser state, see Parsing-impl.h
+  HTTPParserState       parseState;
+  uint16_t              parseError;     // HTTP status code to answer with when parseState is HPS_ERROR
+  HTTPMethod            method;
+  uint8_t               version;
+  uint8_t               flags;
+  uint8_t               encodings;      // HTTP_ENCODING_* accepted by the client
+  uint8_t               headerCount;    // kept headers, stored as "name\0value\0" from headersStart
+  uint16_t              bufLen;
+  uint16_t              tokenStart;     // start of the header line being parsed
+  uint16_t              valueStart;     // start of the header value being parsed
+  uint16_t              queryStart;     // 0 if the URI has no query string
+  uint16_t              headersStart;
+  uint16_t              boundaryStart;  // multipart boundary, inside the kept Content-Type value
+  uint32_t              contentLength;
+  uint32_t              bodyRead;
+  String                body;
+  uint16_t              requestCount;   // requests already served on this connection
+
+  uint16_t              rxPos;
+  uint16_t              rxLen;
+  uint8_t               rx[HTTP_RX_BUFLEN];
+  char                  buf[HTTP_REQUEST_BUFLEN];
+} ethernetHTTPConnection;
+
+// Stream view of a connection slot. Serves the bytes already buffered by the request parser,
+// then reads the socket in HTTP_RX_BUFLEN blocks rather than one byte at a time.
+// Reads stop at limit bytes, so that a request body is never read into the next pipelined request
+class ethernetConnectionStream : public Stream
+{
+  public:
+
+    explicit ethernetConnectionStream(ethernetHTTPConnection& conn, uint32_t limit = 0xFFFFFFFF)
+      : _conn(conn), _remaining(limit)
+    {
+    }
+
+    // Refill conn.rx from the socket once it has been consumed. Returns false if no data is buffered
+    static bool fill(ethernetHTTPConnection& conn)
+    {
+      if (conn.rxPos < conn.rxLen)
+        return true;
+
+      int avail = conn.client.available();
+
+      if (avail <= 0)
+        return false;
+
+      int len = conn.client.read(conn.rx, (avail < HTTP_RX_BUFLEN) ? avail : HTTP_RX_BUFLEN);
+
+      if (len <= 0)
+        return false;
+
+      conn.rxPos = 0;
+      conn.rxLen = len;
+
+      return true;
+    }
+
+    int available() override
+    {
+      uint32_t avail = (_conn.rxLen - _conn.rxPos) + _conn.client.available();
+
+      return (avail < _remaining) ? avail : _remaining;
+    }
+
+    int read() override
+    {
+      if (!_remaining || !fill(_conn))
+        return -1;
+
+      _remaining--;
+
+      return _conn.rx[_conn.rxPos++];
+    }
+
+    int peek() override
+    {
+      if (!_remaining || !fill(_conn))
+        return -1;
+
+      return _conn.rx[_conn.rxPos];
+    }
+
+    size_t write(uint8_t b) override
+    {
+      return _conn.client.write(b);
+    }
+
+    uint8_t connected()
+    {
+      return _remaining && ( (_conn.rxPos < _conn.rxLen) || _conn.client.connected() );
+    }
+
+    uint32_t remaining() const
+    {
+      return _remaining;
+    }
+
+    // Bulk access to the buffered bytes. Waits up to getTimeout() ms for data, returns nullptr on timeout
+    const uint8_t* peekBlock(size_t& len)
+    {
+      unsigned long startMillis = millis();
+
+      len = 0;
+
+      if (!_remaining)
+        return nullptr;
+
+      while (!fill(_conn))
+      {
+        if (!_conn.client.connected() || (millis() - startMillis > getTimeout()))
+          return nullptr;
+
+        yield();
+      }
+
+      len = _conn.rxLen - _conn.rxPos;
+
+      if (len > _remaining)
+        len = _remaining;
+
+      return _conn.rx + _conn.rxPos;
+    }
+
+    // Make at least len bytes (len <= HTTP_RX_BUFLEN) contiguous in the buffer, reading more if needed
+    bool require(size_t len)
+    {
+      unsigned long startMillis = millis();
+
+      if (len > _remaining || len > HTTP_RX_BUFLEN)
+        return false;
+
+      while ((size_t) (_conn.rxLen - _conn.rxPos) < len)
+      {
+        if (_conn.rxPos)
+        {
+          // Move the tail to the front to make room
+          memmove(_conn.rx, _conn.rx + _conn.rxPos, _conn.rxLen - _conn.rxPos);
+          _conn.rxLen -= _conn.rxPos;
+          _conn.rxPos  = 0;
+        }
+
+        int avail = _conn.client.available();
+
+        if (avail > 0)
+        {
+          int size = _conn.client.read(_conn.rx + _conn.rxLen,
+                                       (avail < HTTP_RX_BUFLEN - _conn.rxLen) ? avail : HTTP_RX_BUFLEN - _conn.rxLen);
+
+          if (size > 0)
+            _conn.rxLen += size;
+        }
+        else if (!_conn.client.connected() || (millis() - startMillis > getTimeout()))
+        {
+          return false;
+        }
+        else
+        {
+          yield();
+        }
+      }
+
+      return true;
+    }
+
+    void skip(size_t len)
+    {
+      _conn.rxPos += len;
+      _remaining  -= len;
+    }
+
+  private:
+
+    ethernetHTTPConnection& _conn;
+    uint32_t                _remaining;
+};
+
 #include "detail/RequestHandler.h"
 
+class ethernetRouteNode;
+class ethernetDeflate;
+
 #if (defined(ESP32) || defined(ESP8266))
   #include "FS.h"
 #endif
@@ -360,6 +712,14 @@ class EthernetWebServer
     void on(const String &uri, HTTPMethod method, THandlerFunction fn);
     void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn);
     void addHandler(ethernetRequestHandler* handler);
+
+    // GET uri always answers the same response, serialized once here and replayed with a single write.
+    // onStatic_P() leaves content in flash, onStatic() copies it
+    void onStatic(const String& uri, int code, const char* content_type, const String& content);
+    void onStatic(const String& uri, int code, const char* content_type, const char* content, size_t contentLength);
+    void onStatic_P(const String& uri, int code, const char* content_type, PGM_P content);
+
+    void setStaticRouter(ethernetRequestHandler& router);   // fixed route table, tried first and never deleted by the server
     void onNotFound(THandlerFunction fn);  //called when handler is not assigned
     void onFileUpload(THandlerFunction fn); //handle file uploads
 
@@ -375,6 +735,9 @@ class EthernetWebServer
 
     EthernetClient client()
     {
+      // The handler may write to the client directly, the buffered part of the response goes first
+      _flushResponse();
+
       return _currentClient;
     }
 
@@ -390,6 +753,7 @@ class EthernetWebServer
     }
 #endif
 
+    String pathArg(unsigned int i);        // get "{param}" value of the matched route by number
     String arg(const String& name);        // get request argument value by name
     String arg(int i);              // get request argument value by number
     String argName(int i);          // get request argument name by number
@@ -398,6 +762,9 @@ class EthernetWebServer
     bool hasArg(const String& name);       // check if argument exists
     void collectHeaders(const char* headerKeys[], const size_t headerKeysCount); // set the request headers to collect
     String header(const String& name);      // get request header value by name
+#if USE_NEW_WEBSERVER_VERSION
+    const char* header(const char* name, size_t& length);   // get request header value by name without copy, nullptr if absent
+#endif
     String header(int i);              // get request header value by number
     String headerName(int i);          // get request header name by number
     int headers();                     // get header count
@@ -405,6 +772,29 @@ class EthernetWebServer
 
     String hostHeader();            // get request host header if available or empty String if not
 
+    // true if the Accept-Encoding header allows one of the HTTP_ENCODING_* codings
+    bool acceptsEncoding(uint8_t encoding)
+    {
+      return (_acceptEncoding & encoding) != 0;
+    }
+
+    // true if the If-None-Match header of the request is etag, quotes included. The header is kept
+    // without collectHeaders()
+    bool ifNoneMatch(const char* etag)
+    {
+#if USE_NEW_WEBSERVER_VERSION
+      return _ifNoneMatch && !strcmp(_ifNoneMatch, etag);
+#else
+      return _ifNoneMatch.length() && (_ifNoneMatch == etag);
+#endif
+    }
+
+    // Answer the "Range" header of the request for a body of size bytes. Adds Accept-Ranges and Content-Range,
+    // sets the content length and returns 206 with the part to send in start and length. Returns 200 for the
+    // whole body when there is no range, several ones or an If-Range that doesn't match the ETag or
+    // Last-Modified header of the response, and 416 with nothing to send when the range is past the end
+    int setContentRange(size_t size, size_t& start, size_t& length);
+
     // send response to the client
     // code - HTTP response code, can be 200 or 404
     // content_type - HTTP content type, like "text/plain" or "image/png"
@@ -439,9 +829,34 @@ class EthernetWebServer
 		}
 
 		////////////////////////////////////////
+
+		// Compress responses of unknown length, see setContentLength(CONTENT_LENGTH_UNKNOWN), with gzip
+		// or deflate when the client accepts it. Costs 2 x HTTP_DEFLATE_WINDOW + (2 << HTTP_DEFLATE_HASH_BITS)
+		// + HTTP_DEFLATE_OUTBUF bytes of heap, about 3.5 KB at the defaults
+		inline void enableCompression(bool value = true)
+		{
+			_compressionEnabled = value;
+		}
+
+		////////////////////////////////////////
+
+#if USE_NEW_WEBSERVER_VERSION
+
+		// Leave bodies other than forms in the socket for the handler to pull with readBody().
+		// arg("plain") then reads the rest of the body on first use
+		inline void enableBodyStreaming(bool value = true)
+		{
+			_streamBody = value;
+		}
+
+    size_t readBody(uint8_t* buf, size_t len);    // read the next part of the request body, 0 at its end
+
+		////////////////////////////////////////
+#endif
 		
     void setContentLength(size_t contentLength);
     void sendHeader(const String& name, const String& value, bool first = false);
+    void sendHeader(const char* name, const char* value, bool first = false);
     //void sendHeader(const EWString& name, const EWString& value, bool first = false);
     void sendContent(const String& content);
     void sendContent(const String& content, size_t size);
@@ -459,20 +874,29 @@ class EthernetWebServer
     //////
 
     static String urlDecode(const String& text);
+    static size_t urlDecode(char* text, size_t len);    // in place, returns the decoded length
 
 #if !(defined(ESP32) || defined(ESP8266))
     template<typename T> size_t streamFile(T &file, const String& contentType)
     {
       using namespace mime;
-      setContentLength(file.size());
 
-      if (String(file.name()).endsWith(mimeTable[gz].endsWith) && contentType != mimeTable[gz].mimeType &&
-          contentType != mimeTable[none].mimeType)
+      size_t start;
+      size_t length;
+      int    code = setContentRange(file.size(), start, length);
+
+      if ( (getType(file.name()) == gz) && contentType != mime::contentType(gz) &&
+          contentType != mime::contentType(none) )
       {
         sendHeader("Content-Encoding", "gzip");
       }
 
-      send(200, contentType, "");
+      send(code, contentType, "");
+
+      if (code != 200)
+        return _streamFileRange(file, start, length);
+
+      _flushResponse();
 
       return _currentClient.write(file);
     }
@@ -498,7 +922,13 @@ class EthernetWebServer
     template<typename T> 
     size_t streamFile(T &file, const String& contentType, const int code = 200)
       {
-				_streamFileCore(file.size(), file.name(), contentType, code);
+				size_t start;
+				size_t length = _streamFileCore(file.size(), file.name(), contentType, code, start);
+
+				if (length != file.size())
+					return _streamFileRange(file, start, length);
+
+				_flushResponse();
 				
     		return _currentClient.write(file);     
       }
@@ -509,43 +939,73 @@ class EthernetWebServer
 
   protected:
   
+    friend class ethernetCachedResponseHandler;
+    friend class ethernetDeflate;
+
   	////////////////////////////////////////
   
 		virtual size_t _currentClientWrite(const char* buffer, size_t length) 
 		{ 
-			return _currentClient.write( buffer, length ); 
+			return _write( buffer, length ); 
 		}
 
 		////////////////////////////////////////
 	
     void _addRequestHandler(ethernetRequestHandler* handler);
+    ethernetRequestHandler* _findHandler();
+
+#if USE_NEW_WEBSERVER_VERSION
+    void _acceptClient();
+    bool _handleConnection(ethernetHTTPConnection& conn);
+    void _releaseConnection(ethernetHTTPConnection& conn);
+#endif
+
     void _handleRequest();
     void _finalizeResponse();
-    bool _parseRequest(EthernetClient& client);
+    size_t _write(const void* data, size_t len);    // buffered write of the response
+    void _write_P(PGM_P data, size_t len);
+    void _writeP(const __FlashStringHelper* text);
+    void _writeNumber(size_t value);
+    void _writeChunkSize(size_t size);
+    void _writeHeader(const __FlashStringHelper* name, const char* value);
+    void _writeHeader(const __FlashStringHelper* name, const __FlashStringHelper* value);
+    void _writeHeader(const __FlashStringHelper* name, size_t value);
+    void _flushResponse();
+    void _writeConnectionHeaders();
+    void _sendCompressed(const uint8_t* data, size_t len);
+    void _sendCached(const char* head, size_t headLen, PGM_P content, size_t contentLength, bool contentInFlash);
 
     //KH
 #if USE_NEW_WEBSERVER_VERSION
-    void _parseArguments(const String& data);
-    int  _parseArgumentsPrivate(const String& data, vl::Func<void(String&, String&, const String&, int, int, int, int)> handler);
-    bool _parseForm(EthernetClient& client, const String& boundary, uint32_t len);
+    void _resetParser(ethernetHTTPConnection& conn);
+    HTTPParserState _parseRequest(ethernetHTTPConnection& conn);
+    HTTPParserState _parseError(ethernetHTTPConnection& conn, uint16_t code);
+    bool _parseHeader(ethernetHTTPConnection& conn, const char* headerName, const char* headerValue);
+    int  _findHeader(const char* headerName);
+    static uint32_t _headerHash(const char* headerName);
+    bool _setupRequest(ethernetHTTPConnection& conn);
+    bool _readPlainBody();
+    void _parseArguments(char* data, size_t len);
+    bool _parseForm(ethernetConnectionStream& client, const String& boundary, uint32_t len);
+    void _uploadWriteBlock(const uint8_t* data, size_t len);
 #else
+    bool _parseRequest(EthernetClient& client);
+    bool _collectHeader(const char* headerName, const char* headerValue);
     void _parseArguments(const String& data);
     bool _parseForm(EthernetClient& client, const String& boundary, uint32_t len);
+    uint8_t _uploadReadByte(EthernetClient& client);
+    void _uploadWriteByte(uint8_t b);
 #endif
 
     static String _responseCodeToString(int code);
+    static const __FlashStringHelper* _responseCodeReason(int code);
     bool _parseFormUploadAborted();
-    void _uploadWriteByte(uint8_t b);
-    uint8_t _uploadReadByte(EthernetClient& client);
-    void _prepareHeader(String& response, int code, const char* content_type, size_t contentLength);
-
-#if ! ( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
-    void _prepareHeader(EWString& response, int code, const char* content_type, size_t contentLength);
-#endif
-    bool _collectHeader(const char* headerName, const char* headerValue);
+    void _prepareHeader(int code, const char* content_type, size_t contentLength);
+    bool _ifRangeMatches();
 
 #if (defined(ESP32) || defined(ESP8266))
-    void _streamFileCore(const size_t fileSize, const String & fileName, const String & contentType, const int code = 200);
+    size_t _streamFileCore(const size_t fileSize, const String & fileName, const String & contentType, const int code,
+                           size_t& start);
 
     template<typename T>
     size_t _customClientWrite(T &file)
@@ -557,7 +1017,7 @@ class EthernetWebServer
       // read up to sizeof(buffer) bytes
       while ((bytesRead = file.readBytes(buffer, sizeof(buffer))) > 0)
       {
-        _currentClient.write(buffer, bytesRead);
+        _write(buffer, bytesRead);
         contentLength += bytesRead;
       }
 
@@ -565,6 +1025,30 @@ class EthernetWebServer
     }
 #endif
 
+    // Body of a 206 response, length bytes of file from start
+    template<typename T>
+    size_t _streamFileRange(T &file, size_t start, size_t length)
+    {
+      char buffer[64];
+      size_t sent = 0;
+
+      if (length && !file.seek(start))
+        return 0;
+
+      while (sent < length)
+      {
+        size_t bytesRead = file.readBytes(buffer, (length - sent < sizeof(buffer)) ? length - sent : sizeof(buffer));
+
+        if (bytesRead == 0)
+          break;
+
+        _write(buffer, bytesRead);
+        sent += bytesRead;
+      }
+
+      return sent;
+    }
+
     struct RequestArgument
     {
       String key;
@@ -581,12 +1065,22 @@ class EthernetWebServer
     uint8_t           _currentVersion;
     HTTPClientStatus  _currentStatus;
     unsigned long     _statusChange;
-    
+
+#if USE_NEW_WEBSERVER_VERSION
+    ethernetHTTPConnection  _connections[ETHERNET_WEBSERVER_MAX_CLIENTS];
+    uint8_t                 _nextConnection;
+#endif
+
+    bool              _keepAlive;       // keep the connection open after the current response
+
     bool     					_nullDelay;
 
     ethernetRequestHandler*   _currentHandler   = nullptr;
     ethernetRequestHandler*   _firstHandler   	= nullptr;
     ethernetRequestHandler*   _lastHandler   		= nullptr;
+    ethernetRouteNode*        _routes           = nullptr;
+    ethernetRequestHandler*   _staticRouter     = nullptr;
+    ethernetPathArgs          _pathArgs;
     THandlerFunction  				_notFoundHandler;
     THandlerFunction  				_fileUploadHandler;
 
@@ -604,11 +1098,37 @@ class EthernetWebServer
 
     int               _headerKeysCount;
     RequestArgument*  _currentHeaders   				= nullptr;
+#if USE_NEW_WEBSERVER_VERSION
+    ethernetHeaderSlice*  _headerSlices         = nullptr;
+    const char*           _currentHeaderBuf     = nullptr;    // request buffer of the connection being served
+    ethernetHTTPConnection* _currentConnection  = nullptr;
+    uint32_t              _bodyRemaining        = 0;          // streamed body bytes not read by the handler yet
+    bool                  _plainLoaded          = false;      // _readPlainBody() has run for this request
+    int                   _currentArgCapacity   = 0;          // size of _currentArgs
+    bool                  _streamBody           = false;
+#endif
     size_t            _contentLength;
     int              	_clientContentLength;				// "Content-Length" from header of incoming POST or GET request
-    String            _responseHeaders;
+    char              _responseHeaders[HTTP_HEADER_BUFLEN];   // headers added with sendHeader()
+    uint16_t          _responseHeadersLen = 0;
     String            _hostHeader;
+    uint8_t           _acceptEncoding   = 0;      // HTTP_ENCODING_* of the current request
+    uint32_t          _rangeFirst       = HTTP_RANGE_NONE;    // "Range" of the current request
+    uint32_t          _rangeLast        = HTTP_RANGE_NONE;
+    const char*       _ifRange          = nullptr;            // "If-Range" of the current request
+#if USE_NEW_WEBSERVER_VERSION
+    const char*       _ifNoneMatch      = nullptr;            // "If-None-Match" of the current request
+#else
+    String            _ifNoneMatch;
+#endif
+    bool              _compressionEnabled = false;
+    bool              _compressing      = false;    // response body goes through _deflate
+    ethernetDeflate*  _deflate          = nullptr;
     bool              _chunked;
+#if (HTTP_TX_BUFLEN > 0)
+    uint8_t           _txBuf[HTTP_TX_BUFLEN];
+    uint16_t          _txLen            = 0;
+#endif
 };
 
 /////////////////////////////////////////////////////////////////////////
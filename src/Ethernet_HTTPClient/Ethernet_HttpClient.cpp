@@ -44,10 +44,14 @@
 const char* EthernetHttpClient::kUserAgent = "Arduino/2.2.0";
 const char* EthernetHttpClient::kContentLengthPrefix = HTTP_HEADER_CONTENT_LENGTH ": ";
 const char* EthernetHttpClient::kTransferEncodingChunked = HTTP_HEADER_TRANSFER_ENCODING ": " HTTP_HEADER_VALUE_CHUNKED;
+const char* EthernetHttpClient::kConnectionClose = HTTP_HEADER_CONNECTION ": " HTTP_HEADER_VALUE_CLOSE;
+// Psuedo-regexp we're expecting before the status-code
+const char* EthernetHttpClient::kStatusPrefix = "HTTP/*.* ";
 
 EthernetHttpClient::EthernetHttpClient(Client& aClient, const char* aServerName, uint16_t aServerPort)
   : iClient(&aClient), iServerName(aServerName), iServerAddress(), iServerPort(aServerPort),
-    iConnectionClose(true), iSendDefaultRequestHeaders(true)
+    iConnectionClose(true), iSendDefaultRequestHeaders(true), iWaitForDataHook(NULL),
+    iAsyncCallback(NULL)
 {
   resetState();
 }
@@ -59,7 +63,8 @@ EthernetHttpClient::EthernetHttpClient(Client& aClient, const String& aServerNam
 
 EthernetHttpClient::EthernetHttpClient(Client& aClient, const IPAddress& aServerAddress, uint16_t aServerPort)
   : iClient(&aClient), iServerName(NULL), iServerAddress(aServerAddress), iServerPort(aServerPort),
-    iConnectionClose(true), iSendDefaultRequestHeaders(true)
+    iConnectionClose(true), iSendDefaultRequestHeaders(true), iWaitForDataHook(NULL),
+    iAsyncCallback(NULL)
 {
   resetState();
 }
@@ -68,15 +73,23 @@ void EthernetHttpClient::resetState()
 {
   iState          = eIdle;
   iStatusCode     = 0;
+  iStatusPtr      = kStatusPrefix;
+  iStatusLineRead = false;
   iContentLength  = kNoContentLengthHeader;
 
   iBodyLengthConsumed   = 0;
   iContentLengthPtr     = kContentLengthPrefix;
   iTransferEncodingChunkedPtr = kTransferEncodingChunked;
+  iConnectionClosePtr   = kConnectionClose;
 
   iIsChunked            = false;
+  iServerClose          = false;
   iChunkLength          = 0;
+  iChunkDigits          = false;
+  iChunkExtension       = false;
   iHttpResponseTimeout  = kHttpResponseTimeout;
+  iRequestLength        = 0;
+  iAsyncPhase           = eAsyncIdle;
 }
 
 void EthernetHttpClient::stop()
@@ -103,11 +116,20 @@ void EthernetHttpClient::beginRequest()
 int EthernetHttpClient::startRequest(const char* aURLPath, const char* aHttpMethod,
                                      const char* aContentType, int aContentLength, const byte aBody[])
 {
-  if (iState == eReadingBody || iState == eReadingChunkLength || iState == eReadingBodyChunk)
+  if (iState == eReadingBody || iState == eReadingChunkLength || iState == eReadingBodyChunk ||
+      iState == eBodyComplete)
   {
+    bool serverClose = iServerClose;
+
     flushClientRx();
 
     resetState();
+
+    if (serverClose)
+    {
+      // Don't race the server closing its end, connect again below
+      iClient->stop();
+    }
   }
 
   tHttpState initialState = iState;
@@ -165,15 +187,11 @@ int EthernetHttpClient::startRequest(const char* aURLPath, const char* aHttpMeth
     if (initialState == eIdle || hasBody)
     {
       // This was a simple version of the API, so terminate the headers now
-      finishHeaders();
+      // and send them with the body
+      finishHeaders(hasBody ? aBody : NULL, hasBody ? aContentLength : 0);
     }
 
     // else we'll call it in endRequest or in the first call to print, etc.
-
-    if (hasBody)
-    {
-      write(aBody, aContentLength);
-    }
   }
 
   return ret;
@@ -184,27 +202,29 @@ int EthernetHttpClient::sendInitialHeaders(const char* aURLPath, const char* aHt
   ET_LOGDEBUG(F("EthernetHttpClient::startRequest: Connected"));
 
   // Send the HTTP command, i.e. "GET /somepath/ HTTP/1.0"
-  iClient->print(aHttpMethod);
-  iClient->print(" ");
+  bufferRequest(aHttpMethod);
+  bufferRequest(" ");
 
-  iClient->print(aURLPath);
-  iClient->println(" HTTP/1.1");
+  bufferRequest(aURLPath);
+  bufferRequest(" HTTP/1.1\r\n");
 
   if (iSendDefaultRequestHeaders)
   {
     // The host header, if required
     if (iServerName)
     {
-      iClient->print("Host: ");
-      iClient->print(iServerName);
+      bufferRequest("Host: ");
+      bufferRequest(iServerName);
 
       if (iServerPort != kHttpPort)
       {
-        iClient->print(":");
-        iClient->print(iServerPort);
+        char port[7];
+
+        snprintf(port, sizeof(port), ":%u", iServerPort);
+        bufferRequest(port);
       }
 
-      iClient->println();
+      bufferRequest("\r\n");
     }
 
     // And user-agent string
@@ -216,7 +236,7 @@ int EthernetHttpClient::sendInitialHeaders(const char* aURLPath, const char* aHt
   {
     // Tell the server to
     // close this connection after we're done
-    sendHeader(HTTP_HEADER_CONNECTION, "close");
+    sendHeader(HTTP_HEADER_CONNECTION, HTTP_HEADER_VALUE_CLOSE);
   }
 
   // Everything has gone well
@@ -227,27 +247,30 @@ int EthernetHttpClient::sendInitialHeaders(const char* aURLPath, const char* aHt
 
 void EthernetHttpClient::sendHeader(const char* aHeader)
 {
-  iClient->println(aHeader);
+  bufferRequest(aHeader);
+  bufferRequest("\r\n");
 }
 
 void EthernetHttpClient::sendHeader(const char* aHeaderName, const char* aHeaderValue)
 {
-  iClient->print(aHeaderName);
-  iClient->print(": ");
-  iClient->println(aHeaderValue);
+  bufferRequest(aHeaderName);
+  bufferRequest(": ");
+  bufferRequest(aHeaderValue);
+  bufferRequest("\r\n");
 }
 
 void EthernetHttpClient::sendHeader(const char* aHeaderName, const int aHeaderValue)
 {
-  iClient->print(aHeaderName);
-  iClient->print(": ");
-  iClient->println(aHeaderValue);
+  char value[12];
+
+  snprintf(value, sizeof(value), "%d", aHeaderValue);
+  sendHeader(aHeaderName, value);
 }
 
 void EthernetHttpClient::sendBasicAuth(const char* aUser, const char* aPassword)
 {
   // Send the initial part of this header line
-  iClient->print("Authorization: Basic ");
+  bufferRequest("Authorization: Basic ");
   // Now Base64 encode "aUser:aPassword" and send that
   // This seems trickier than it should be but it's mostly to avoid either
   // (a) some arbitrarily sized buffer which hopes to be big enough, or
@@ -286,7 +309,7 @@ void EthernetHttpClient::sendBasicAuth(const char* aUser, const char* aPassword)
       // NUL-terminate the output string
       output[4] = '\0';
       // And write it out
-      iClient->print((char*)output);
+      bufferRequest((char*)output);
       // FIXME We might want to fill output with '=' characters if base64_encode doesn't
       // FIXME do it for us when we're encoding the final chunk
       inputOffset = 0;
@@ -294,15 +317,56 @@ void EthernetHttpClient::sendBasicAuth(const char* aUser, const char* aPassword)
   }
 
   // And end the header we've sent
-  iClient->println();
+  bufferRequest("\r\n");
 }
 
-void EthernetHttpClient::finishHeaders()
+void EthernetHttpClient::finishHeaders(const uint8_t* aBody, size_t aSize)
 {
-  iClient->println();
+  bufferRequest("\r\n");
+
+  if (aBody)
+  {
+    bufferRequest(aBody, aSize);
+  }
+
+  flushRequest();
+
   iState = eRequestSent;
 }
 
+void EthernetHttpClient::bufferRequest(const char* aData)
+{
+  bufferRequest((const uint8_t*) aData, strlen(aData));
+}
+
+void EthernetHttpClient::bufferRequest(const uint8_t* aData, size_t aSize)
+{
+  if (iRequestLength + aSize > sizeof(iRequestBuffer))
+  {
+    flushRequest();
+
+    if (aSize >= sizeof(iRequestBuffer))
+    {
+      // Too big to gather, stream it
+      iClient->write(aData, aSize);
+
+      return;
+    }
+  }
+
+  memcpy(iRequestBuffer + iRequestLength, aData, aSize);
+  iRequestLength += aSize;
+}
+
+void EthernetHttpClient::flushRequest()
+{
+  if (iRequestLength)
+  {
+    iClient->write(iRequestBuffer, iRequestLength);
+    iRequestLength = 0;
+  }
+}
+
 void EthernetHttpClient::flushClientRx()
 {
   while (iClient->available())
@@ -458,12 +522,10 @@ int EthernetHttpClient::responseStatusCode()
     // ignoring them really, and reading the next line for a proper response
     iStatusCode = 0;
     iState      = eRequestSent;
+    iStatusPtr  = kStatusPrefix;
 
     unsigned long timeoutStart = millis();
-
-    // Psuedo-regexp we're expecting before the status-code
-    const char* statusPrefix  = "HTTP/*.* ";
-    const char* statusPtr     = statusPrefix;
+    uint32_t      wait         = kHttpWaitForDataMinDelay;
 
     // Whilst we haven't timed out & haven't reached the end of the headers
     while ((c != '\n') && ( (millis() - timeoutStart) < iHttpResponseTimeout ))
@@ -478,63 +540,21 @@ int EthernetHttpClient::responseStatusCode()
 
         if (c != -1)
         {
-          switch (iState)
+          if (readStatusLine(c) != HTTP_SUCCESS)
           {
-            case eRequestSent:
-
-              // We haven't reached the status code yet
-              if ( (*statusPtr == '*') || (*statusPtr == c) )
-              {
-                // This character matches, just move along
-                statusPtr++;
-
-                if (*statusPtr == '\0')
-                {
-                  // We've reached the end of the prefix
-                  iState = eReadingStatusCode;
-                }
-              }
-              else
-              {
-                return HTTP_ERROR_INVALID_RESPONSE;
-              }
-
-              break;
-
-            case eReadingStatusCode:
-              if (isdigit(c))
-              {
-                // This assumes we won't get more than the 3 digits we
-                // want
-                iStatusCode = iStatusCode * 10 + (c - '0');
-              }
-              else
-              {
-                // We've reached the end of the status code
-                // We could sanity check it here or double-check for ' '
-                // rather than anything else, but let's be lenient
-                iState = eStatusCodeRead;
-              }
-
-              break;
-
-            case eStatusCodeRead:
-              // We're just waiting for the end of the line now
-              break;
-
-            default:
-              break;
-          };
+            return HTTP_ERROR_INVALID_RESPONSE;
+          }
 
           // We read something, reset the timeout counter
           timeoutStart = millis();
+          wait         = kHttpWaitForDataMinDelay;
         }
       }
       else
       {
         // We haven't got any data, so let's pause to allow some to
         // arrive
-        delay(kHttpWaitForDataDelay);
+        waitForData(wait, timeoutStart);
       }
     }
 
@@ -552,6 +572,8 @@ int EthernetHttpClient::responseStatusCode()
   if ( (c == '\n') && (iState == eStatusCodeRead) )
   {
     // We've read the status-line successfully
+    iStatusLineRead = true;
+
     return iStatusCode;
   }
   else if (c != '\n')
@@ -567,10 +589,98 @@ int EthernetHttpClient::responseStatusCode()
   }
 }
 
+int EthernetHttpClient::readStatusLine(int c)
+{
+  switch (iState)
+  {
+    case eRequestSent:
+
+      // We haven't reached the status code yet
+      if ( (*iStatusPtr == '*') || (*iStatusPtr == c) )
+      {
+        if ( (iStatusPtr == kStatusPrefix + 7) && (c == '0') )
+        {
+          // "HTTP/1.0", the server closes the connection after the response
+          iServerClose = true;
+        }
+
+        // This character matches, just move along
+        iStatusPtr++;
+
+        if (*iStatusPtr == '\0')
+        {
+          // We've reached the end of the prefix
+          iState = eReadingStatusCode;
+        }
+      }
+      else
+      {
+        return HTTP_ERROR_INVALID_RESPONSE;
+      }
+
+      break;
+
+    case eReadingStatusCode:
+      if (isdigit(c))
+      {
+        // This assumes we won't get more than the 3 digits we
+        // want
+        iStatusCode = iStatusCode * 10 + (c - '0');
+      }
+      else
+      {
+        // We've reached the end of the status code
+        // We could sanity check it here or double-check for ' '
+        // rather than anything else, but let's be lenient
+        iState = eStatusCodeRead;
+      }
+
+      break;
+
+    case eStatusCodeRead:
+      // We're just waiting for the end of the line now
+      break;
+
+    default:
+      break;
+  };
+
+  return HTTP_SUCCESS;
+}
+
+void EthernetHttpClient::waitForData(uint32_t& aWait, unsigned long aTimeoutStart)
+{
+  unsigned long elapsed = millis() - aTimeoutStart;
+
+  if (elapsed >= iHttpResponseTimeout)
+  {
+    return;
+  }
+
+  uint32_t pause = aWait;
+
+  if (pause > iHttpResponseTimeout - elapsed)
+  {
+    pause = iHttpResponseTimeout - elapsed;
+  }
+
+  if (iWaitForDataHook)
+  {
+    iWaitForDataHook(pause);
+  }
+  else
+  {
+    delay(pause);
+  }
+
+  aWait = (aWait * 2 < kHttpWaitForDataDelay) ? aWait * 2 : kHttpWaitForDataDelay;
+}
+
 int EthernetHttpClient::skipResponseHeaders()
 {
   // Just keep reading until we finish reading the headers or time out
   unsigned long timeoutStart = millis();
+  uint32_t      wait         = kHttpWaitForDataMinDelay;
 
   // Whilst we haven't timed out & haven't reached the end of the headers
   while ((!endOfHeadersReached()) && ( (millis() - timeoutStart) < iHttpResponseTimeout ))
@@ -580,12 +690,13 @@ int EthernetHttpClient::skipResponseHeaders()
       (void)readHeader();
       // We read something, reset the timeout counter
       timeoutStart = millis();
+      wait         = kHttpWaitForDataMinDelay;
     }
     else
     {
       // We haven't got any data, so let's pause to allow some to
       // arrive
-      delay(kHttpWaitForDataDelay);
+      waitForData(wait, timeoutStart);
     }
   }
 
@@ -603,7 +714,8 @@ int EthernetHttpClient::skipResponseHeaders()
 
 bool EthernetHttpClient::endOfHeadersReached()
 {
-  return (iState == eReadingBody || iState == eReadingChunkLength || iState == eReadingBodyChunk);
+  return (iState == eReadingBody || iState == eReadingChunkLength || iState == eReadingBodyChunk
+          || iState == eBodyComplete);
 };
 
 int EthernetHttpClient::contentLength()
@@ -634,29 +746,32 @@ String EthernetHttpClient::responseBody()
     }
   }
 
-  // keep on timedRead'ing, until:
-  //  - we have a content length: body length equals consumed or no bytes
-  //                              available
-  //  - no content length:        no bytes are available
-  while (iBodyLengthConsumed != bodyLength)
-  {
-    // KH test
-    int c = timedRead();
-    //int c = iClient->read();
+  // Read a block at a time until the body ends, or nothing arrives for the response timeout
+  char block[65];
+  int  len;
 
-    ET_LOGDEBUG1(F("EthernetHttpClient::responseBody => c ="), String(c));
-    //////
+  while ((len = readBody((uint8_t*) block, sizeof(block) - 1)) > 0)
+  {
+    block[len] = '\0';
 
-    if (c == -1)
+    if ((int) strlen(block) == len)
     {
-      // read timed out, done
-      break;
+      if (!response.concat(block))
+      {
+        // adding block failed
+        return String((const char*)NULL);
+      }
     }
-
-    if (!response.concat((char)c))
+    else
     {
-      // adding char failed
-      return String((const char*)NULL);
+      // The block has NUL bytes, add it one char at a time
+      for (int i = 0; i < len; i++)
+      {
+        if (!response.concat(block[i]))
+        {
+          return String((const char*)NULL);
+        }
+      }
     }
   }
 
@@ -669,8 +784,124 @@ String EthernetHttpClient::responseBody()
   return response;
 }
 
+int EthernetHttpClient::readBody(uint8_t* aBuffer, size_t aSize)
+{
+  // skip the response headers, if they haven't been read already
+  if (!endOfHeadersReached())
+  {
+    skipResponseHeaders();
+  }
+
+  size_t        bytesRead     = 0;
+  unsigned long timeoutStart  = millis();
+  uint32_t      wait          = kHttpWaitForDataMinDelay;
+
+  while ( (bytesRead < aSize) && endOfHeadersReached() && !bodyComplete() )
+  {
+    size_t size = aSize - bytesRead;
+
+    if ( !iIsChunked && (iContentLength > 0) && (size > (size_t) (iContentLength - iBodyLengthConsumed)) )
+    {
+      // Don't read past the body
+      size = iContentLength - iBodyLengthConsumed;
+    }
+
+    int ret = read(aBuffer + bytesRead, size);
+
+    if (ret > 0)
+    {
+      bytesRead    += ret;
+      timeoutStart  = millis();
+      wait          = kHttpWaitForDataMinDelay;
+    }
+    else if ( (!iClient->connected() && !iClient->available()) || ( (millis() - timeoutStart) >= iHttpResponseTimeout ) )
+    {
+      // Closed by the server, which ends a body without length, or timed out
+      break;
+    }
+    else
+    {
+      waitForData(wait, timeoutStart);
+    }
+  }
+
+  return bytesRead;
+}
+
+int EthernetHttpClient::responseBodyTo(Print& aOut)
+{
+  uint8_t block[64];
+  int     total = 0;
+  int     len;
+
+  while ((len = readBody(block, sizeof(block))) > 0)
+  {
+    aOut.write(block, len);
+    total += len;
+  }
+
+  if (!bodyComplete() && (iIsChunked || (iContentLength != kNoContentLengthHeader)))
+  {
+    return HTTP_ERROR_TIMED_OUT;
+  }
+
+  return total;
+}
+
+int EthernetHttpClient::responseBodyTo(uint8_t* aBuffer, size_t aSize)
+{
+  int len = readBody(aBuffer, aSize);
+
+  if (bodyComplete())
+  {
+    return len;
+  }
+
+  if ( ((size_t) len == aSize) && (iIsChunked || (iContentLength != kNoContentLengthHeader) || iClient->connected()) )
+  {
+    // Buffer full before the end of the body
+    return HTTP_ERROR_API;
+  }
+
+  if (iIsChunked || (iContentLength != kNoContentLengthHeader))
+  {
+    return HTTP_ERROR_TIMED_OUT;
+  }
+
+  return len;
+}
+
+bool EthernetHttpClient::bodyComplete()
+{
+  if (iState == eBodyComplete)
+  {
+    return true;
+  }
+
+  if (iIsChunked)
+  {
+    // Parse the framing that has already arrived
+    available();
+
+    return (iState == eBodyComplete);
+  }
+
+  if ( (iStatusCode == 204) || (iStatusCode == 304) )
+  {
+    // No body
+    return true;
+  }
+
+  return (iContentLength != kNoContentLengthHeader) && (iBodyLengthConsumed >= iContentLength);
+}
+
 bool EthernetHttpClient::endOfBodyReached()
 {
+  if (iState == eBodyComplete)
+  {
+    return true;
+  }
+
   if (endOfHeadersReached() && (contentLength() != kNoContentLengthHeader))
   {
     // We've got to the body and we know how long it will be
@@ -680,38 +911,53 @@ bool EthernetHttpClient::endOfBodyReached()
   return false;
 }
 
-int EthernetHttpClient::available()
+void EthernetHttpClient::readChunkLength()
 {
-  if (iState == eReadingChunkLength)
+  while (iClient->available())
   {
-    while (iClient->available())
-    {
-      char c = iClient->read();
+    int c = iClient->read();
 
-      if (c == '\n')
-      {
-        iState = eReadingBodyChunk;
-        break;
-      }
-      else if (c == '\r')
+    if (c == '\n')
+    {
+      if (!iChunkDigits)
       {
-        // no-op
+        // CRLF ending the data of the previous chunk
+        continue;
       }
-      else if (isHexadecimalDigit(c))
-      {
-        char digit[2] = {c, '\0'};
 
-        iChunkLength = (iChunkLength * 16) + strtol(digit, NULL, 16);
-      }
+      // A chunk of size 0 is the last one, followed only by optional trailers
+      iState          = (iChunkLength == 0) ? eBodyComplete : eReadingBodyChunk;
+      iChunkDigits    = false;
+      iChunkExtension = false;
+
+      return;
+    }
+
+    if ( iChunkExtension || (c == '\r') )
+    {
+      continue;
+    }
+
+    if (c == ';')
+    {
+      iChunkExtension = true;
+    }
+    else if (isHexadecimalDigit(c))
+    {
+      iChunkDigits = true;
+      iChunkLength = (iChunkLength * 16) + ( (c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10 );
     }
   }
+}
 
-  if (iState == eReadingBodyChunk && iChunkLength == 0)
+int EthernetHttpClient::available()
+{
+  if (iState == eReadingChunkLength)
   {
-    iState = eReadingChunkLength;
+    readChunkLength();
   }
 
-  if (iState == eReadingChunkLength)
+  if ( (iState == eReadingChunkLength) || (iState == eBodyComplete) )
   {
     return 0;
   }
@@ -825,6 +1071,22 @@ String EthernetHttpClient::readHeaderValue()
 
 int EthernetHttpClient::read(uint8_t *buf, size_t size)
 {
+  if (iIsChunked && endOfHeadersReached())
+  {
+    // Don't read past the data of the current chunk
+    int chunkAvailable = available();
+
+    if (chunkAvailable <= 0)
+    {
+      return 0;
+    }
+
+    if (size > (size_t) chunkAvailable)
+    {
+      size = chunkAvailable;
+    }
+  }
+
   int ret = iClient->read(buf, size);
 
   if (endOfHeadersReached() && iContentLength > 0)
@@ -837,9 +1099,26 @@ int EthernetHttpClient::read(uint8_t *buf, size_t size)
     }
   }
 
+  if ( (ret > 0) && (iState == eReadingBodyChunk) )
+  {
+    iChunkLength -= ret;
+
+    if (iChunkLength == 0)
+    {
+      iState = eReadingChunkLength;
+    }
+  }
+
   return ret;
 }
 
+// Next character of the header prefix aPrefix after c, NULL once the line can't
+// be that header anymore. Header names and values are compared ignoring case
+static const char* matchHeaderPrefix(const char* aPrefix, char c)
+{
+  return (aPrefix && (tolower(*aPrefix) == tolower(c))) ? aPrefix + 1 : NULL;
+}
+
 int EthernetHttpClient::readHeader()
 {
   char c = read();
@@ -858,44 +1137,47 @@ int EthernetHttpClient::readHeader()
     case eStatusCodeRead:
 
       // We're at the start of a line, or somewhere in the middle of reading
-      // the Content-Length prefix
-      if (*iContentLengthPtr == c)
+      // one of the prefixes we're after
+      if ( (c == '\r') && (iContentLengthPtr == kContentLengthPrefix) &&
+           (iTransferEncodingChunkedPtr == kTransferEncodingChunked) && (iConnectionClosePtr == kConnectionClose) )
       {
-        // This character matches, just move along
-        iContentLengthPtr++;
+        // We've found a '\r' at the start of a line, so this is probably
+        // the end of the headers
+        iState = eLineStartingCRFound;
 
-        if (*iContentLengthPtr == '\0')
-        {
-          // We've reached the end of the prefix
-          iState = eReadingContentLength;
-          // Just in case we get multiple Content-Length headers, this
-          // will ensure we just get the value of the last one
-          iContentLength = 0;
-          iBodyLengthConsumed = 0;
-        }
+        break;
       }
-      else if (*iTransferEncodingChunkedPtr == c)
-      {
-        // This character matches, just move along
-        iTransferEncodingChunkedPtr++;
 
-        if (*iTransferEncodingChunkedPtr == '\0')
-        {
-          // We've reached the end of the Transfer Encoding: chunked header
-          iIsChunked = true;
-          iState = eSkipToEndOfHeader;
-        }
+      // "Content-Length" and "Connection" start alike, so each prefix is
+      // followed on its own until it no longer matches
+      iContentLengthPtr           = matchHeaderPrefix(iContentLengthPtr, c);
+      iTransferEncodingChunkedPtr = matchHeaderPrefix(iTransferEncodingChunkedPtr, c);
+      iConnectionClosePtr         = matchHeaderPrefix(iConnectionClosePtr, c);
+
+      if (iContentLengthPtr && (*iContentLengthPtr == '\0'))
+      {
+        // We've reached the end of the prefix
+        iState = eReadingContentLength;
+        // Just in case we get multiple Content-Length headers, this
+        // will ensure we just get the value of the last one
+        iContentLength = 0;
+        iBodyLengthConsumed = 0;
       }
-      else if (((iContentLengthPtr == kContentLengthPrefix) && (iTransferEncodingChunkedPtr == kTransferEncodingChunked))
-               && (c == '\r'))
+      else if (iTransferEncodingChunkedPtr && (*iTransferEncodingChunkedPtr == '\0'))
       {
-        // We've found a '\r' at the start of a line, so this is probably
-        // the end of the headers
-        iState = eLineStartingCRFound;
+        // We've reached the end of the Transfer Encoding: chunked header
+        iIsChunked = true;
+        iState = eSkipToEndOfHeader;
       }
-      else
+      else if (iConnectionClosePtr && (*iConnectionClosePtr == '\0'))
       {
-        // This isn't the Content-Length or Transfer Encoding chunked header, skip to the end of the line
+        // The server closes the connection after this response
+        iServerClose = true;
+        iState = eSkipToEndOfHeader;
+      }
+      else if (!iContentLengthPtr && !iTransferEncodingChunkedPtr && !iConnectionClosePtr)
+      {
+        // This isn't a header we're after, skip to the end of the line
         iState = eSkipToEndOfHeader;
       }
 
@@ -943,8 +1225,167 @@ int EthernetHttpClient::readHeader()
     iState = eStatusCodeRead;
     iContentLengthPtr = kContentLengthPrefix;
     iTransferEncodingChunkedPtr = kTransferEncodingChunked;
+    iConnectionClosePtr = kConnectionClose;
   }
 
   // And return the character read to whoever wants it
   return c;
 }
+
+EthernetHttpClient::tHttpAsyncEvent EthernetHttpClient::poll()
+{
+  if ( (iState < eRequestSent) || (iAsyncPhase == eAsyncDone) )
+  {
+    return eAsyncIdle;
+  }
+
+  if (iAsyncPhase == eAsyncIdle)
+  {
+    iAsyncLastData = millis();
+
+    return asyncEvent(eAsyncConnected);
+  }
+
+  if (iAsyncPhase == eAsyncConnected)
+  {
+    return pollHeaders();
+  }
+
+  return pollBody();
+}
+
+EthernetHttpClient::tHttpAsyncEvent EthernetHttpClient::pollHeaders()
+{
+  while (!endOfHeadersReached() && iClient->available())
+  {
+    iAsyncLastData = millis();
+
+    if (iStatusLineRead)
+    {
+      readHeader();
+
+      continue;
+    }
+
+    int c = read();
+
+    if (c != '\n')
+    {
+      if (readStatusLine(c) != HTTP_SUCCESS)
+      {
+        return asyncError(HTTP_ERROR_INVALID_RESPONSE);
+      }
+    }
+    else if (iState != eStatusCodeRead)
+    {
+      // This wasn't a properly formed status line
+      return asyncError(HTTP_ERROR_INVALID_RESPONSE);
+    }
+    else if (iStatusCode < 200 && iStatusCode != 101)
+    {
+      // Informational (1xx), read the next status line
+      iStatusCode = 0;
+      iState      = eRequestSent;
+      iStatusPtr  = kStatusPrefix;
+    }
+    else
+    {
+      iStatusLineRead = true;
+    }
+  }
+
+  if (endOfHeadersReached())
+  {
+    return asyncEvent(eAsyncHeaders);
+  }
+
+  if ( (millis() - iAsyncLastData) >= iHttpResponseTimeout )
+  {
+    return asyncError(HTTP_ERROR_TIMED_OUT);
+  }
+
+  return eAsyncWaiting;
+}
+
+EthernetHttpClient::tHttpAsyncEvent EthernetHttpClient::pollBody()
+{
+  if (bodyComplete())
+  {
+    return asyncEvent(eAsyncDone);
+  }
+
+  if (iAsyncCallback)
+  {
+    uint8_t block[64];
+    size_t  size = sizeof(block);
+
+    if ( !iIsChunked && (iContentLength > 0) && (size > (size_t) (iContentLength - iBodyLengthConsumed)) )
+    {
+      // Don't read past the body
+      size = iContentLength - iBodyLengthConsumed;
+    }
+
+    int len = read(block, size);
+
+    if (len > 0)
+    {
+      iAsyncLastData = millis();
+
+      return asyncEvent(eAsyncBody, block, len);
+    }
+  }
+  else if (available() > 0)
+  {
+    // Left for read()
+    iAsyncLastData = millis();
+
+    return eAsyncBody;
+  }
+
+  if (!iClient->connected() && !iClient->available())
+  {
+    // Closed by the server, which only ends a body without length
+    if (iIsChunked || (iContentLength != kNoContentLengthHeader))
+    {
+      return asyncError(HTTP_ERROR_INVALID_RESPONSE);
+    }
+
+    return asyncEvent(eAsyncDone);
+  }
+
+  if ( (millis() - iAsyncLastData) >= iHttpResponseTimeout )
+  {
+    return asyncError(HTTP_ERROR_TIMED_OUT);
+  }
+
+  return eAsyncWaiting;
+}
+
+EthernetHttpClient::tHttpAsyncEvent EthernetHttpClient::asyncEvent(tHttpAsyncEvent aEvent, const uint8_t* aData,
+                                                                   size_t aSize)
+{
+  if ( (aEvent == eAsyncConnected) || (aEvent == eAsyncHeaders) || (aEvent == eAsyncDone) )
+  {
+    iAsyncPhase = aEvent;
+  }
+  else if (aEvent == eAsyncError)
+  {
+    iAsyncPhase = eAsyncDone;
+  }
+
+  if (iAsyncCallback)
+  {
+    iAsyncCallback(*this, aEvent, aData, aSize);
+  }
+
+  return aEvent;
+}
+
+EthernetHttpClient::tHttpAsyncEvent EthernetHttpClient::asyncError(int aError)
+{
+  ET_LOGDEBUG1(F("EthernetHttpClient::poll: Error ="), aError);
+
+  iStatusCode = aError;
+
+  return asyncEvent(eAsyncError);
+}
@@ -75,10 +75,32 @@ static const int HTTP_ERROR_INVALID_RESPONSE = -4;
 #define HTTP_HEADER_TRANSFER_ENCODING "Transfer-Encoding"
 #define HTTP_HEADER_USER_AGENT        "User-Agent"
 #define HTTP_HEADER_VALUE_CHUNKED     "chunked"
-
-// Number of milliseconds that we wait each time there isn't any data
-// available to be read (during status code and header processing)
-#define kHttpWaitForDataDelay     1000L
+#define HTTP_HEADER_VALUE_CLOSE       "close"
+
+// Longest pause, in milliseconds, while there isn't any data available to be
+// read (during status code and header processing). The first pause is
+// kHttpWaitForDataMinDelay, then each one is twice as long up to this, so a
+// quick server is noticed within a few milliseconds
+#if !defined(kHttpWaitForDataDelay)
+  #define kHttpWaitForDataDelay     100L
+#endif
+
+#define kHttpWaitForDataMinDelay    1L
+
+// Pause of up to aMaxWait milliseconds while waiting for the server, see
+// EthernetHttpClient::setWaitForDataHook()
+typedef void (*HttpWaitForDataHook)(uint32_t aMaxWait);
+
+// Size of the buffer a request is put together in, from the request line to a
+// body passed to startRequest(), so that it is sent with one write() to the
+// client rather than a write per string. Anything longer is sent in pieces
+#if !defined(kHttpRequestBufferSize)
+  #if defined(__AVR__)
+    #define kHttpRequestBufferSize  64
+  #else
+    #define kHttpRequestBufferSize  512
+  #endif
+#endif
 
 // Number of milliseconds that we'll wait in total without receiveing any
 // data before returning HTTP_ERROR_TIMED_OUT (during status code and header
@@ -314,7 +336,8 @@ class EthernetHttpClient : public Client
     bool endOfHeadersReached();
 
     /** Test whether the end of the body has been reached.
-      Only works if the Content-Length header was returned by the server
+      Only works if the Content-Length header was returned by the server, or
+      the body is chunked
       @return true if we are now at the end of the body, else false
     */
     bool endOfBodyReached();
@@ -352,6 +375,31 @@ class EthernetHttpClient : public Client
     */
     String responseBody();
 
+    /** Read up to aSize bytes of the body, in blocks as they arrive from the
+      socket. Chunked bodies are decoded. Waits for more data until aSize
+      bytes are read, the body ends or nothing arrives for the response timeout
+      Also skips response headers if they have not been read already
+      MUST be called after responseStatusCode()
+      @return Number of bytes read
+    */
+    int readBody(uint8_t* aBuffer, size_t aSize);
+
+    /** Write the whole response body to aOut, a block at a time
+      Also skips response headers if they have not been read already
+      MUST be called after responseStatusCode()
+      @return Number of bytes written, or HTTP_ERROR_TIMED_OUT if the body
+      didn't end before the response timeout
+    */
+    int responseBodyTo(Print& aOut);
+
+    /** Read the response body into aBuffer
+      Also skips response headers if they have not been read already
+      MUST be called after responseStatusCode()
+      @return Length of the body, or HTTP_ERROR_TIMED_OUT if it didn't end
+      before the response timeout, or HTTP_ERROR_API if it is longer than aSize
+    */
+    int responseBodyTo(uint8_t* aBuffer, size_t aSize);
+
     /** Enables connection keep-alive mode
     */
     void connectionKeepAlive();
@@ -435,7 +483,64 @@ class EthernetHttpClient : public Client
       iHttpResponseTimeout = timeout;
     };
 
+    /** Replace the delay() used while waiting for the status line and the
+      headers, e.g. with a call blocking on an RTOS event until data arrives.
+      The hook may return early, the socket is checked again anyway
+      @param aHook  Function to call, or NULL for delay()
+    */
+    void setWaitForDataHook(HttpWaitForDataHook aHook)
+    {
+      iWaitForDataHook = aHook;
+    };
+
+    // What poll() found
+    typedef enum
+    {
+      eAsyncIdle,         // no request sent, or its end already reported
+      eAsyncWaiting,      // nothing new yet
+      eAsyncConnected,    // the request has been sent
+      eAsyncHeaders,      // the status line and headers have been read
+      eAsyncBody,         // part of the body has arrived
+      eAsyncDone,         // the body has ended
+      eAsyncError         // timed out or not a valid response, see statusCode()
+    } tHttpAsyncEvent;
+
+    /** Called by poll() with each event. aData and aSize are the part of the
+      body for eAsyncBody, else NULL and 0
+    */
+    typedef void (*tHttpAsyncCallback)(EthernetHttpClient& aClient, tHttpAsyncEvent aEvent,
+                                       const uint8_t* aData, size_t aSize);
+
+    /** Follow the response to a request without waiting for it, instead of
+      responseStatusCode() and the calls reading the headers and body.
+      Send the request as usual, e.g. with get(), then call poll() from loop()
+      until it returns eAsyncDone or eAsyncError. Each call handles what has
+      arrived and reports at most one event. Without a callback, the body is
+      left for read() after eAsyncBody
+      Connecting to the server in get(), etc. still blocks
+      @return Event found, see tHttpAsyncEvent
+    */
+    tHttpAsyncEvent poll();
+
+    /** Have poll() pass each event, and the body, to aCallback
+      @param aCallback  Function to call, or NULL to read the body with read()
+    */
+    void setAsyncCallback(tHttpAsyncCallback aCallback)
+    {
+      iAsyncCallback = aCallback;
+    };
+
+    /** Status code of the response once poll() has reported eAsyncHeaders,
+      or the error after eAsyncError
+    */
+    int statusCode()
+    {
+      return iStatusCode;
+    };
+
   protected:
+    friend class EthernetHttpClientPool;
+
     /** Reset internal state data back to the "just initialised" state
     */
     void resetState();
@@ -448,16 +553,61 @@ class EthernetHttpClient : public Client
     int sendInitialHeaders(const char* aURLPath,
                            const char* aHttpMethod);
 
-    /* Let the server know that we've reached the end of the headers
+    /* Let the server know that we've reached the end of the headers, and
+      send the request with aBody, if any
+    */
+    void finishHeaders(const uint8_t* aBody = NULL, size_t aSize = 0);
+
+    /** Add to the request being put together, see kHttpRequestBufferSize
     */
-    void finishHeaders();
+    void bufferRequest(const char* aData);
+    void bufferRequest(const uint8_t* aData, size_t aSize);
+
+    /** Send what has been put together of the request
+    */
+    void flushRequest();
 
     /** Reading any pending data from the client (used in connection keep alive mode)
     */
     void flushClientRx();
 
+    /** Pause while no data is available, without going past the response
+      timeout counted from aTimeoutStart
+      @param aWait  Length of this pause, doubled for the next one
+    */
+    void waitForData(uint32_t& aWait, unsigned long aTimeoutStart);
+
+    /** Parse the size line of the next chunk, as far as it has arrived
+    */
+    void readChunkLength();
+
+    /** Test whether all of the body has been read, as far as can be told
+      without waiting
+    */
+    bool bodyComplete();
+
+    /** Handle a character of the status line
+      @return HTTP_SUCCESS, or HTTP_ERROR_INVALID_RESPONSE if it isn't one
+    */
+    int readStatusLine(int c);
+
+    /** Parts of poll() before and after the end of the headers
+    */
+    tHttpAsyncEvent pollHeaders();
+    tHttpAsyncEvent pollBody();
+
+    /** Report aEvent to the callback of poll()
+    */
+    tHttpAsyncEvent asyncEvent(tHttpAsyncEvent aEvent, const uint8_t* aData = NULL, size_t aSize = 0);
+
+    /** End the response followed by poll() with error aError
+    */
+    tHttpAsyncEvent asyncError(int aError);
+
     static const char* kContentLengthPrefix;
     static const char* kTransferEncodingChunked;
+    static const char* kConnectionClose;
+    static const char* kStatusPrefix;
 
     typedef enum
     {
@@ -471,7 +621,8 @@ class EthernetHttpClient : public Client
       eLineStartingCRFound,
       eReadingBody,
       eReadingChunkLength,
-      eReadingBodyChunk
+      eReadingBodyChunk,
+      eBodyComplete       // last chunk of a chunked body read
     } tHttpState;
 
     // Client we're using
@@ -485,6 +636,10 @@ class EthernetHttpClient : public Client
     tHttpState iState;
     // Stores the status code for the response, once known
     int iStatusCode;
+    // How far through the status line prefix we are, and whether the whole
+    // line has been read
+    const char* iStatusPtr;
+    bool iStatusLineRead;
     // Stores the value of the Content-Length header, if present
     int iContentLength;
     // How many bytes of the response body have been read by the user
@@ -493,14 +648,32 @@ class EthernetHttpClient : public Client
     const char* iContentLengthPtr;
     // How far through a Transfer-Encoding chunked header we are
     const char* iTransferEncodingChunkedPtr;
+    // How far through a Connection close header we are
+    const char* iConnectionClosePtr;
+    // Whether the server closes the connection after this response, from a
+    // Connection close header or an HTTP/1.0 status line
+    bool iServerClose;
     // Stores if the response body is chunked
     bool iIsChunked;
     // Stores the value of the current chunk length, if present
     int iChunkLength;
+    // Whether the chunk size line being parsed has digits, or is an extension
+    bool iChunkDigits;
+    bool iChunkExtension;
     uint32_t iHttpResponseTimeout;
     bool iConnectionClose;
     bool iSendDefaultRequestHeaders;
+    HttpWaitForDataHook iWaitForDataHook;
     String iHeaderLine;
+    // Request being put together, see kHttpRequestBufferSize
+    uint8_t iRequestBuffer[kHttpRequestBufferSize];
+    uint16_t iRequestLength;
+    // Last event reported by poll(): eAsyncIdle, eAsyncConnected,
+    // eAsyncHeaders, or eAsyncDone once the response has ended
+    tHttpAsyncEvent iAsyncPhase;
+    tHttpAsyncCallback iAsyncCallback;
+    // When poll() last found data, for the response timeout
+    unsigned long iAsyncLastData;
 };
 
 #endif  // ETHERNET_HTTP_CLIENT_H
@@ -0,0 +1,184 @@
+/****************************************************************************************************************************
+  Ethernet_HttpClientPool.cpp - Dead simple HTTP WebClient.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+
+  Original author:
+  @file       Esp8266WebServer.h
+  @author     Ivan Grokhotkov
+
+  Version: 2.4.1
+
+  Version Modified By   Date      Comments
+  ------- -----------  ---------- -----------
+  1.0.0   K Hoang      13/02/2020 Initial coding for Arduino Mega, Teensy, etc to support Ethernetx libraries
+  ...
+  2.2.0   K Hoang      05/05/2022 Add support to custom SPI for Teensy, Mbed RP2040, Portenta_H7, etc.
+  2.2.1   K Hoang      25/08/2022 Auto-select SPI SS/CS pin according to board package
+  2.2.2   K Hoang      06/09/2022 Slow SPI clock for old W5100 shield or SAMD Zero. Improve support for SAMD21
+  2.2.3   K Hoang      17/09/2022 Add support to AVR Dx (AVR128Dx, AVR64Dx, AVR32Dx, etc.) using DxCore
+  2.2.4   K Hoang      26/10/2022 Add support to Seeed XIAO_NRF52840 and XIAO_NRF52840_SENSE using `mbed` or `nRF52` core
+  2.3.0   K Hoang      15/11/2022 Add new features, such as CORS. Update code and examples to send big data
+  2.4.0   K Hoang      22/12/2022 Fix compile errors for new ESP32 core v2.0.6
+  2.4.1   K Hoang      06/01/2023 Add support to `WIZNet W6100` using IPv4
+ *************************************************************************************************************************************/
+
+// Keep-alive connections for EthernetHttpClient, shared by requests to the same servers
+
+#define _ETHERNET_WEBSERVER_LOGLEVEL_     0
+
+#include "detail/Debug.h"
+#include "Ethernet_HTTPClient/Ethernet_HttpClientPool.h"
+
+EthernetHttpClientPool::~EthernetHttpClientPool()
+{
+  for (uint8_t i = 0; i < iSize; i++)
+  {
+    iSlots[i].iHttp->stop();
+
+    delete iSlots[i].iHttp;
+  }
+}
+
+void EthernetHttpClientPool::addClient(Client& aClient)
+{
+  tSlot& slot = iSlots[iSize++];
+
+  slot.iHttp     = new EthernetHttpClient(aClient, (const char*) NULL);
+  slot.iLastUsed = 0;
+  slot.iBusy     = false;
+
+  slot.iHttp->connectionKeepAlive();
+}
+
+EthernetHttpClient* EthernetHttpClientPool::acquire(const char* aServerName, uint16_t aServerPort)
+{
+  return acquire(aServerName, IPAddress(), aServerPort);
+}
+
+EthernetHttpClient* EthernetHttpClientPool::acquire(const IPAddress& aServerAddress, uint16_t aServerPort)
+{
+  return acquire(NULL, aServerAddress, aServerPort);
+}
+
+EthernetHttpClient* EthernetHttpClientPool::acquire(const char* aServerName, const IPAddress& aServerAddress,
+                                                    uint16_t aServerPort)
+{
+  tSlot* spare = NULL;
+
+  evictIdle();
+
+  for (uint8_t i = 0; i < iSize; i++)
+  {
+    tSlot& slot = iSlots[i];
+    EthernetHttpClient* http = slot.iHttp;
+
+    if (slot.iBusy)
+    {
+      continue;
+    }
+
+    bool sameServer = (http->iServerPort == aServerPort) &&
+                      (aServerName ? (http->iServerName && !strcmp(http->iServerName, aServerName)) :
+                       (!http->iServerName && (http->iServerAddress == aServerAddress)));
+
+    if (sameServer)
+    {
+      // Drop what is left of the last response. A server which has closed the
+      // connection meanwhile shows once nothing is left to read
+      http->flushClientRx();
+
+      if (http->connected())
+      {
+        ET_LOGDEBUG(F("EthernetHttpClientPool::acquire: Reusing connection"));
+
+        http->resetState();
+
+        slot.iBusy     = true;
+        slot.iLastUsed = millis();
+
+        return http;
+      }
+
+      http->stop();
+    }
+
+    // A free socket, else the connection unused the longest
+    if (!spare || (spare->iHttp->connected() &&
+                   (!http->connected() || ((long) (slot.iLastUsed - spare->iLastUsed) < 0))))
+    {
+      spare = &slot;
+    }
+  }
+
+  if (!spare)
+  {
+    ET_LOGDEBUG(F("EthernetHttpClientPool::acquire: All connections in use"));
+
+    return NULL;
+  }
+
+  // Connected by the first request
+  spare->iHttp->stop();
+
+  spare->iHttp->iServerName    = aServerName;
+  spare->iHttp->iServerAddress = aServerAddress;
+  spare->iHttp->iServerPort    = aServerPort;
+
+  spare->iBusy     = true;
+  spare->iLastUsed = millis();
+
+  return spare->iHttp;
+}
+
+void EthernetHttpClientPool::release(EthernetHttpClient* aHttp)
+{
+  for (uint8_t i = 0; i < iSize; i++)
+  {
+    tSlot& slot = iSlots[i];
+
+    if (slot.iHttp != aHttp)
+    {
+      continue;
+    }
+
+    if ((aHttp->iState != EthernetHttpClient::eIdle) && !aHttp->endOfBodyReached())
+    {
+      ET_LOGDEBUG(F("EthernetHttpClientPool::release: Response not read, closing"));
+
+      aHttp->stop();
+    }
+    else if (aHttp->iServerClose)
+    {
+      // "Connection: close" or HTTP/1.0, the server is closing its end
+      ET_LOGDEBUG(F("EthernetHttpClientPool::release: Closed by server"));
+
+      aHttp->stop();
+    }
+
+    slot.iBusy     = false;
+    slot.iLastUsed = millis();
+
+    return;
+  }
+}
+
+void EthernetHttpClientPool::evictIdle()
+{
+  for (uint8_t i = 0; i < iSize; i++)
+  {
+    tSlot& slot = iSlots[i];
+
+    if (!slot.iBusy && (millis() - slot.iLastUsed > iIdleTimeout) && slot.iHttp->connected())
+    {
+      ET_LOGDEBUG(F("EthernetHttpClientPool::evictIdle: Closing idle connection"));
+
+      slot.iHttp->stop();
+    }
+  }
+}
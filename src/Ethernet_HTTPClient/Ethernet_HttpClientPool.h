@@ -0,0 +1,120 @@
+/****************************************************************************************************************************
+  Ethernet_HttpClientPool.h - Dead simple HTTP WebClient.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+
+  Original author:
+  @file       Esp8266WebServer.h
+  @author     Ivan Grokhotkov
+
+  Version: 2.4.1
+
+  Version Modified By   Date      Comments
+  ------- -----------  ---------- -----------
+  1.0.0   K Hoang      13/02/2020 Initial coding for Arduino Mega, Teensy, etc to support Ethernetx libraries
+  ...
+  2.2.0   K Hoang      05/05/2022 Add support to custom SPI for Teensy, Mbed RP2040, Portenta_H7, etc.
+  2.2.1   K Hoang      25/08/2022 Auto-select SPI SS/CS pin according to board package
+  2.2.2   K Hoang      06/09/2022 Slow SPI clock for old W5100 shield or SAMD Zero. Improve support for SAMD21
+  2.2.3   K Hoang      17/09/2022 Add support to AVR Dx (AVR128Dx, AVR64Dx, AVR32Dx, etc.) using DxCore
+  2.2.4   K Hoang      26/10/2022 Add support to Seeed XIAO_NRF52840 and XIAO_NRF52840_SENSE using `mbed` or `nRF52` core
+  2.3.0   K Hoang      15/11/2022 Add new features, such as CORS. Update code and examples to send big data
+  2.4.0   K Hoang      22/12/2022 Fix compile errors for new ESP32 core v2.0.6
+  2.4.1   K Hoang      06/01/2023 Add support to `WIZNet W6100` using IPv4
+ *************************************************************************************************************************************/
+
+// Keep-alive connections for EthernetHttpClient, shared by requests to the same servers
+
+#pragma once
+
+#ifndef ETHERNET_HTTP_CLIENT_POOL_H
+#define ETHERNET_HTTP_CLIENT_POOL_H
+
+#include <Arduino.h>
+
+#include "detail/Debug.h"
+#include "Ethernet_HTTPClient/Ethernet_HttpClient.h"
+
+// Most connections a pool keeps open, each one holds a socket of the Ethernet
+// chip. A W5100 has 4, leave at least one for the server
+#if !defined(kHttpPoolSize)
+  #define kHttpPoolSize             3
+#endif
+
+// Number of milliseconds an unused connection is kept open. Servers close idle
+// keep-alive connections themselves after 5 to 75 seconds
+#if !defined(kHttpPoolIdleTimeout)
+  #define kHttpPoolIdleTimeout      10000L
+#endif
+
+class EthernetHttpClientPool
+{
+  public:
+    /** Pool of connections through aClients, one socket each. No more than
+      kHttpPoolSize of them are used
+      @param aClients     Clients the connections are made with, e.g. EthernetClient clients[3]
+      @param aIdleTimeout Milliseconds an unused connection is kept open
+    */
+    template<typename T, size_t N>
+    EthernetHttpClientPool(T (&aClients)[N], uint32_t aIdleTimeout = kHttpPoolIdleTimeout)
+      : iSize(0), iIdleTimeout(aIdleTimeout)
+    {
+      for (size_t i = 0; (i < N) && (i < kHttpPoolSize); i++)
+      {
+        addClient(aClients[i]);
+      }
+    }
+
+    virtual ~EthernetHttpClientPool();
+
+    EthernetHttpClientPool(const EthernetHttpClientPool&) = delete;
+    EthernetHttpClientPool& operator=(const EthernetHttpClientPool&) = delete;
+
+    /** Get a client for a request to aServerName:aServerPort, on the open
+      connection to that server if there is one. Otherwise it connects with
+      the first request, through a free socket or the one unused the longest
+      aServerName is kept, not copied, as with EthernetHttpClient
+      @return Client to make requests with, or NULL if all of them are in use
+    */
+    EthernetHttpClient* acquire(const char* aServerName, uint16_t aServerPort = EthernetHttpClient::kHttpPort);
+    EthernetHttpClient* acquire(const IPAddress& aServerAddress, uint16_t aServerPort = EthernetHttpClient::kHttpPort);
+
+    /** Hand back a client from acquire(). The connection stays open for the
+      next request only if the response was read to the end of its body,
+      otherwise what is left of it can't be told from the next response
+    */
+    void release(EthernetHttpClient* aHttp);
+
+    /** Close the connections unused for longer than the idle timeout, e.g.
+      from loop(). acquire() does it too
+    */
+    void evictIdle();
+
+    void setIdleTimeout(uint32_t aIdleTimeout)
+    {
+      iIdleTimeout = aIdleTimeout;
+    };
+
+  protected:
+    typedef struct
+    {
+      EthernetHttpClient* iHttp;
+      unsigned long iLastUsed;
+      bool iBusy;
+    } tSlot;
+
+    void addClient(Client& aClient);
+
+    EthernetHttpClient* acquire(const char* aServerName, const IPAddress& aServerAddress, uint16_t aServerPort);
+
+    tSlot iSlots[kHttpPoolSize];
+    uint8_t iSize;
+    uint32_t iIdleTimeout;
+};
+
+#endif  // ETHERNET_HTTP_CLIENT_POOL_H
@@ -42,42 +42,828 @@
 
 ////////////////////////////////////////
 
-// KH
+// HTTP_ENCODING_* mask of the codings listed in an Accept-Encoding header. "*" stands for all of them,
+// a coding with "q=0" is refused
+static uint8_t parseAcceptEncoding(const char* headerValue)
+{
+  uint8_t encodings = 0;
+
+  while (*headerValue)
+  {
+    while ( (*headerValue == ' ') || (*headerValue == ',') )
+      headerValue++;
+
+    const char* coding = headerValue;
+
+    while ( *headerValue && (*headerValue != ',') && (*headerValue != ';') && (*headerValue != ' ') )
+      headerValue++;
+
+    size_t  len   = headerValue - coding;
+    uint8_t match = 0;
+
+    if ( (len == 4) && !strncasecmp(coding, "gzip", 4) )
+      match = HTTP_ENCODING_GZIP;
+    else if ( (len == 7) && !strncasecmp(coding, "deflate", 7) )
+      match = HTTP_ENCODING_DEFLATE;
+    else if ( (len == 2) && !strncasecmp(coding, "br", 2) )
+      match = HTTP_ENCODING_BR;
+    else if ( (len == 1) && (*coding == '*') )
+      match = HTTP_ENCODING_GZIP | HTTP_ENCODING_DEFLATE | HTTP_ENCODING_BR;
+
+    // Parameters, only "q=0", "q=0.0"... matters
+    bool refused = false;
+
+    while ( *headerValue && (*headerValue != ',') )
+    {
+      if ( ( (headerValue[0] == 'q') || (headerValue[0] == 'Q') ) && (headerValue[1] == '=') )
+      {
+        const char* q = headerValue + 2;
+
+        refused = (*q == '0');
+
+        for (q++; *q && (*q != ',') && (*q != ';') && (*q != ' '); q++)
+        {
+          if ( (*q != '.') && (*q != '0') )
+            refused = false;
+        }
+
+        headerValue = q;
+      }
+      else
+      {
+        headerValue++;
+      }
+    }
+
+    if (!refused)
+      encodings |= match;
+  }
+
+  return encodings;
+}
+
+////////////////////////////////////////
+
+// First and last byte of a "Range: bytes=" header, HTTP_RANGE_NONE for the part that is left out:
+// "bytes=100-" has no last byte, "bytes=-100" (the last 100 bytes) no first one. Lists of several
+// ranges aren't served, the whole body is sent for them
+static bool parseRange(const char* headerValue, uint32_t& first, uint32_t& last)
+{
+  if (strncasecmp(headerValue, "bytes=", 6) != 0)
+    return false;
+
+  headerValue += 6;
+
+  if (strchr(headerValue, ','))
+    return false;
+
+  char* end;
+
+  first = HTTP_RANGE_NONE;
+  last  = HTTP_RANGE_NONE;
+
+  if (isdigit(*headerValue))
+  {
+    first       = strtoul(headerValue, &end, 10);
+    headerValue = end;
+  }
+
+  if (*headerValue++ != '-')
+    return false;
+
+  if (isdigit(*headerValue))
+  {
+    last        = strtoul(headerValue, &end, 10);
+    headerValue = end;
+  }
+  else if (first == HTTP_RANGE_NONE)
+  {
+    return false;
+  }
+
+  return (*headerValue == 0) && ( (first == HTTP_RANGE_NONE) || (last == HTTP_RANGE_NONE) || (first <= last) );
+}
+
+////////////////////////////////////////
+
 #if USE_NEW_WEBSERVER_VERSION
 
 ////////////////////////////////////////
 
-static bool readBytesWithTimeout(EthernetClient& client, size_t maxLength, String& data, int timeout_ms)
+// Append len bytes of a body to str a block at a time. concat(const char*, unsigned int) isn't public in
+// every core, so each block is NUL-terminated for concat(const char*), only one holding a NUL goes byte by byte
+static bool concatBody(String& str, const uint8_t* data, size_t len)
+{
+  char block[33];
+
+  while (len)
+  {
+    size_t size = (len < sizeof(block) - 1) ? len : sizeof(block) - 1;
+
+    memcpy(block, data, size);
+    block[size] = 0;
+
+    if (strlen(block) == size)
+    {
+      if (!str.concat(block))
+        return false;
+    }
+    else
+    {
+      for (size_t i = 0; i < size; i++)
+      {
+        if (!str.concat(block[i]))
+          return false;
+      }
+    }
+
+    data += size;
+    len  -= size;
+  }
+
+  return true;
+}
+
+////////////////////////////////////////
+
+// Append one byte to the connection's request buffer, false if it is full
+static inline bool appendRequestBuf(ethernetHTTPConnection& conn, char c)
+{
+  if (conn.bufLen >= HTTP_REQUEST_BUFLEN)
+    return false;
+
+  conn.buf[conn.bufLen++] = c;
+
+  return true;
+}
+
+////////////////////////////////////////
+
+static HTTPMethod parseMethod(const char* methodStr)
+{
+  if (strcmp(methodStr, "HEAD") == 0)
+    return HTTP_HEAD;
+  else if (strcmp(methodStr, "POST") == 0)
+    return HTTP_POST;
+  else if (strcmp(methodStr, "DELETE") == 0)
+    return HTTP_DELETE;
+  else if (strcmp(methodStr, "OPTIONS") == 0)
+    return HTTP_OPTIONS;
+  else if (strcmp(methodStr, "PUT") == 0)
+    return HTTP_PUT;
+  else if (strcmp(methodStr, "PATCH") == 0)
+    return HTTP_PATCH;
+
+  return HTTP_GET;
+}
+
+////////////////////////////////////////
+
+// Look for token in a comma separated header value such as "keep-alive, Upgrade"
+static bool headerHasToken(const char* headerValue, const char* token)
+{
+  size_t tokenLen = strlen(token);
+
+  while (*headerValue)
+  {
+    while ( (*headerValue == ' ') || (*headerValue == ',') )
+      headerValue++;
+
+    if ( (strncasecmp(headerValue, token, tokenLen) == 0)
+         && ( (headerValue[tokenLen] == 0) || (headerValue[tokenLen] == ',') || (headerValue[tokenLen] == ' ') ) )
+    {
+      return true;
+    }
+
+    while ( *headerValue && (*headerValue != ',') )
+      headerValue++;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////
+
+void EthernetWebServer::_resetParser(ethernetHTTPConnection& conn)
+{
+  conn.parseState     = HPS_METHOD;
+  conn.parseError     = 0;
+  conn.method         = HTTP_GET;
+  conn.version        = 0;
+  conn.flags          = 0;
+  conn.encodings      = 0;
+  conn.headerCount    = 0;
+  conn.bufLen         = 0;
+  conn.tokenStart     = 0;
+  conn.valueStart     = 0;
+  conn.queryStart     = 0;
+  conn.headersStart   = 0;
+  conn.boundaryStart  = 0;
+  conn.contentLength  = 0;
+  conn.bodyRead       = 0;
+  conn.body           = String();
+}
+
+////////////////////////////////////////
+
+HTTPParserState EthernetWebServer::_parseError(ethernetHTTPConnection& conn, uint16_t code)
+{
+  ET_LOGDEBUG1(F("_parseRequest: Invalid request, code ="), code);
+
+  conn.parseError = code;
+  conn.parseState = HPS_ERROR;
+
+  return HPS_ERROR;
+}
+
+////////////////////////////////////////
+
+// Feed whatever the client has sent so far through the request parser, without waiting for more.
+// Returns HPS_DONE once the request head (and body, if not multipart) is complete, HPS_ERROR on
+// a malformed request, any other state if more data is needed on a later handleClient() call
+HTTPParserState EthernetWebServer::_parseRequest(ethernetHTTPConnection& conn)
+{
+  while (conn.parseState < HPS_BODY)
+  {
+    if (!ethernetConnectionStream::fill(conn))
+      return conn.parseState;
+
+    conn.statusChange = millis();
+
+    while ( (conn.rxPos < conn.rxLen) && (conn.parseState < HPS_BODY) )
+    {
+      char c = conn.rx[conn.rxPos++];
+
+      switch (conn.parseState)
+      {
+        case HPS_METHOD:
+
+          // First line of HTTP request looks like "GET /path?search HTTP/1.1"
+          if (c == ' ')
+          {
+            conn.buf[conn.bufLen] = 0;
+            conn.method   = parseMethod(conn.buf);
+            conn.bufLen   = 0;
+            conn.parseState = HPS_URI;
+          }
+          else if (c == '\r' || c == '\n')
+          {
+            // Tolerate empty lines before the request line
+            if (conn.bufLen)
+              return _parseError(conn, 400);
+          }
+          else if (conn.bufLen >= 7)
+          {
+            return _parseError(conn, 400);
+          }
+          else
+          {
+            conn.buf[conn.bufLen++] = c;
+          }
+
+          break;
+
+        case HPS_URI:
+
+          if (c == ' ')
+          {
+            if (!appendRequestBuf(conn, 0))
+              return _parseError(conn, 414);
+
+            conn.tokenStart = conn.bufLen;
+            conn.parseState = HPS_VERSION;
+          }
+          else if (c == '\r' || c == '\n')
+          {
+            return _parseError(conn, 400);
+          }
+          else if ( (c == '?') && !conn.queryStart )
+          {
+            // Split "/path?search" in place
+            if (!appendRequestBuf(conn, 0))
+              return _parseError(conn, 414);
+
+            conn.queryStart = conn.bufLen;
+          }
+          else if (!appendRequestBuf(conn, c))
+          {
+            return _parseError(conn, 414);
+          }
+
+          break;
+
+        case HPS_VERSION:
+
+          if (c == '\n')
+          {
+            if (!appendRequestBuf(conn, 0))
+              return _parseError(conn, 400);
+
+            // "HTTP/1.1" => 1
+            const char* dot = strchr(conn.buf + conn.tokenStart, '.');
+
+            conn.version      = dot ? atoi(dot + 1) : 0;
+            conn.bufLen       = conn.tokenStart;
+            conn.headersStart = conn.bufLen;
+            conn.parseState   = HPS_HEADER_NAME;
+          }
+          else if ( (c != '\r') && !appendRequestBuf(conn, c) )
+          {
+            return _parseError(conn, 400);
+          }
+
+          break;
+
+        case HPS_HEADER_NAME:
+
+          if (c == '\n')
+          {
+            if (conn.bufLen == conn.tokenStart)
+            {
+              // Empty line, no more headers
+              if (conn.flags & HPF_TRANSFER_ENCODING)
+              {
+                // Chunked request bodies aren't decoded, without their length the next request can't be found
+                return _parseError(conn, 411);
+              }
+              else if ( conn.contentLength && _streamBody && !(conn.flags & (HPF_MULTIPART | HPF_FORM_ENCODED)) )
+              {
+                // Handler reads the body with readBody()
+                conn.flags |= HPF_STREAM_BODY;
+                conn.parseState = HPS_DONE;
+              }
+              else if (conn.contentLength && !(conn.flags & HPF_MULTIPART))
+              {
+                // try to reserve contentLength bytes
+                if (!conn.body.reserve(conn.contentLength))
+                  return _parseError(conn, 413);
+
+                conn.parseState = HPS_BODY;
+              }
+              else
+              {
+                // Multipart body is read by _parseForm() when the request is dispatched
+                conn.parseState = HPS_DONE;
+              }
+            }
+            else
+            {
+              // Not a "name: value" line, ignore it
+              conn.bufLen = conn.tokenStart;
+            }
+          }
+          else if (c == ':')
+          {
+            const char* headerName = conn.buf + conn.tokenStart;
+
+            // A header that doesn't fit could be one that frames the request, refuse rather than guess
+            if (!appendRequestBuf(conn, 0))
+              return _parseError(conn, 431);
+
+            conn.flags &= ~HPF_KEEP_HEADER;
+
+            if ( (_findHeader(headerName) >= 0) || (strcasecmp(headerName, "Host") == 0)
+                 || (strcasecmp(headerName, "Content-Type") == 0) || (strcasecmp(headerName, "Range") == 0)
+                 || (strcasecmp(headerName, "If-Range") == 0) || (strcasecmp(headerName, "If-None-Match") == 0) )
+            {
+              conn.flags |= HPF_KEEP_HEADER;
+            }
+            else if ( (strcasecmp(headerName, "Content-Length") != 0) && (strcasecmp(headerName, "Connection") != 0)
+                      && (strcasecmp(headerName, "Accept-Encoding") != 0)
+                      && (strcasecmp(headerName, "Transfer-Encoding") != 0) )
+            {
+              // Not needed by the server nor the handler, don't store it
+              conn.bufLen     = conn.tokenStart;
+              conn.parseState = HPS_HEADER_SKIP;
+
+              break;
+            }
+
+            conn.valueStart = conn.bufLen;
+            conn.parseState = HPS_HEADER_VALUE;
+          }
+          else if ( (c != '\r') && !appendRequestBuf(conn, c) )
+          {
+            return _parseError(conn, 431);
+          }
+
+          break;
+
+        case HPS_HEADER_VALUE:
+
+          if (c == '\n')
+          {
+            // trim trailing whitespace
+            while ( (conn.bufLen > conn.valueStart) && isspace(conn.buf[conn.bufLen - 1]) )
+              conn.bufLen--;
+
+            if (!appendRequestBuf(conn, 0))
+            {
+              ET_LOGWARN1(F("_parseRequest: No room for header"), conn.buf + conn.tokenStart);
+
+              return _parseError(conn, 431);
+            }
+
+            if (!_parseHeader(conn, conn.buf + conn.tokenStart, conn.buf + conn.valueStart))
+              return _parseError(conn, 400);
+
+            if (conn.flags & HPF_KEEP_HEADER)
+              conn.headerCount++;
+            else
+              conn.bufLen = conn.tokenStart;
+
+            conn.tokenStart = conn.bufLen;
+            conn.parseState = HPS_HEADER_NAME;
+          }
+          else if ( (c == '\r') || ( ((c == ' ') || (c == '\t')) && (conn.bufLen == conn.valueStart) ) )
+          {
+            // skip leading whitespace
+          }
+          else if (!appendRequestBuf(conn, c))
+          {
+            ET_LOGWARN1(F("_parseRequest: No room for header"), conn.buf + conn.tokenStart);
+
+            return _parseError(conn, 431);
+          }
+
+          break;
+
+        case HPS_HEADER_SKIP:
+
+          if (c == '\n')
+          {
+            conn.tokenStart = conn.bufLen;
+            conn.parseState = HPS_HEADER_NAME;
+          }
+
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+
+  // Read the body, as much as has arrived
+  while (conn.parseState == HPS_BODY)
+  {
+    if (!ethernetConnectionStream::fill(conn))
+      return conn.parseState;
+
+    conn.statusChange = millis();
+
+    uint32_t size = conn.rxLen - conn.rxPos;
+
+    if (size > conn.contentLength - conn.bodyRead)
+      size = conn.contentLength - conn.bodyRead;
+
+    concatBody(conn.body, conn.rx + conn.rxPos, size);
+
+    conn.rxPos    += size;
+    conn.bodyRead += size;
+
+    if (conn.bodyRead >= conn.contentLength)
+      conn.parseState = HPS_DONE;
+  }
+
+  return conn.parseState;
+}
+
+////////////////////////////////////////
+
+// Pick up the headers the server itself needs while the request is being parsed. False if the
+// request can't be framed safely
+bool EthernetWebServer::_parseHeader(ethernetHTTPConnection& conn, const char* headerName, const char* headerValue)
+{
+  ET_LOGDEBUG1(F("headerName:"), headerName);
+  ET_LOGDEBUG1(F("headerValue:"), headerValue);
+
+  if (strcasecmp(headerName, "Content-Length") == 0)
+  {
+    uint32_t contentLength = strtoul(headerValue, NULL, 10);
+
+    // Two different lengths, a proxy in front may have used the other one
+    if ( (conn.flags & HPF_CONTENT_LENGTH) && (contentLength != conn.contentLength) )
+      return false;
+
+    conn.contentLength  = contentLength;
+    conn.flags         |= HPF_CONTENT_LENGTH;
+  }
+  else if (strcasecmp(headerName, "Connection") == 0)
+  {
+    if (headerHasToken(headerValue, "close"))
+      conn.flags |= HPF_CONN_CLOSE;
+    else if (headerHasToken(headerValue, "keep-alive"))
+      conn.flags |= HPF_CONN_KEEP_ALIVE;
+  }
+  else if (strcasecmp(headerName, "Transfer-Encoding") == 0)
+  {
+    conn.flags |= HPF_TRANSFER_ENCODING;
+  }
+  else if (strcasecmp(headerName, "Accept-Encoding") == 0)
+  {
+    conn.encodings = parseAcceptEncoding(headerValue);
+  }
+  else if (strcasecmp(headerName, "Content-Type") == 0)
+  {
+    if (strncasecmp(headerValue, "application/x-www-form-urlencoded", 33) == 0)
+    {
+      conn.flags |= HPF_FORM_ENCODED;
+    }
+    else if (strncasecmp(headerValue, "multipart/", 10) == 0)
+    {
+      const char* boundary = strchr(headerValue, '=');
+
+      if (boundary)
+      {
+        conn.flags |= HPF_MULTIPART;
+        conn.boundaryStart = (boundary + 1) - conn.buf;
+      }
+    }
+  }
+
+  return true;
+}
+
+////////////////////////////////////////
+
+size_t EthernetWebServer::readBody(uint8_t* buf, size_t len)
+{
+  if (!_currentConnection || !_bodyRemaining || !len)
+    return 0;
+
+  ethernetHTTPConnection& conn = *_currentConnection;
+  unsigned long startMillis = millis();
+
+  // Wait for the next part, then hand over what is buffered without waiting for more
+  while (!ethernetConnectionStream::fill(conn))
+  {
+    if (!conn.client.connected() || (millis() - startMillis > HTTP_MAX_POST_WAIT))
+    {
+      ET_LOGDEBUG(F("readBody: Timeout"));
+
+      return 0;
+    }
+
+    yield();
+  }
+
+  size_t size = conn.rxLen - conn.rxPos;
+
+  if (size > len)
+    size = len;
+
+  if (size > _bodyRemaining)
+    size = _bodyRemaining;
+
+  memcpy(buf, conn.rx + conn.rxPos, size);
+
+  conn.rxPos      += size;
+  _bodyRemaining  -= size;
+
+  return size;
+}
+
+////////////////////////////////////////
+
+// Read the rest of a streamed body into the "plain" argument. Runs once per request, a body
+// which didn't fit in memory or didn't arrive in time is left out rather than passed on in part
+bool EthernetWebServer::_readPlainBody()
 {
-  if (!data.reserve(maxLength + 1))
+  _plainLoaded = true;
+
+  String body;
+
+  if (!body.reserve(_bodyRemaining))
     return false;
 
-  data[0] = 0;  // data.clear()??
+  uint8_t buf[64];
+  size_t  size;
 
-  while (data.length() < maxLength)
+  while ( (size = readBody(buf, sizeof(buf))) )
   {
-    int tries = timeout_ms;
-    size_t avail;
+    concatBody(body, buf, size);
+  }
 
-    while (!(avail = client.available()) && tries--)
-      delay(1);
+  if (_bodyRemaining)
+  {
+    // Timed out, the rest of the body can't be told apart from a next request
+    _keepAlive = false;
 
-    if (!avail)
-      break;
+    return false;
+  }
+
+  // _parseArguments() leaves a spare argument for "plain"
+  if (_currentArgCount >= _currentArgCapacity)
+    return false;
+
+  RequestArgument& arg = _currentArgs[_currentArgCount++];
+  arg.key   = F("plain");
+  arg.value = static_cast<String&&>(body);     // std::move(), without <utility> which AVR doesn't have
+
+  return true;
+}
+
+////////////////////////////////////////
+
+// Case-insensitive FNV-1a of a header name
+uint32_t EthernetWebServer::_headerHash(const char* headerName)
+{
+  uint32_t hash = 2166136261UL;
+
+  while (*headerName)
+    hash = (hash ^ (uint8_t) tolower(*headerName++)) * 16777619UL;
+
+  return hash;
+}
+
+////////////////////////////////////////
+
+// Index of headerName in the collected headers, -1 if it isn't collected
+int EthernetWebServer::_findHeader(const char* headerName)
+{
+  uint32_t hash = _headerHash(headerName);
+
+  for (int i = 0; i < _headerKeysCount; i++)
+  {
+    if ( (_headerSlices[i].hash == hash) && (strcasecmp(_currentHeaders[i].key.c_str(), headerName) == 0) )
+      return i;
+  }
+
+  return -1;
+}
+
+////////////////////////////////////////
+
+// Make the parsed request of conn the current request. Reads the multipart body, if any
+bool EthernetWebServer::_setupRequest(ethernetHTTPConnection& conn)
+{
+  _currentMethod        = conn.method;
+  _currentVersion       = conn.version;
+  _currentUri           = conn.buf;
+  _clientContentLength  = conn.contentLength;
+  _acceptEncoding       = conn.encodings;
+  _rangeFirst           = HTTP_RANGE_NONE;
+  _rangeLast            = HTTP_RANGE_NONE;
+  _ifRange              = nullptr;
+  _ifNoneMatch          = nullptr;
+  _chunked              = false;
+  _hostHeader           = String();
+
+  // HTTP/1.1 connections are persistent unless the client asks otherwise, HTTP/1.0 ones only on request
+  _keepAlive = (conn.version ? !(conn.flags & HPF_CONN_CLOSE) : (conn.flags & HPF_CONN_KEEP_ALIVE))
+               && (conn.requestCount + 1 < HTTP_KEEPALIVE_MAX_REQUESTS);
+
+  // Collected header values are slices of conn.buf, valid until the response is sent
+  _currentHeaderBuf = conn.buf;
+
+  for (int i = 0; i < _headerKeysCount; ++i)
+  {
+    _headerSlices[i].length = 0;
+  }
+
+  const char* headerName = conn.buf + conn.headersStart;
+
+  for (uint8_t i = 0; i < conn.headerCount; i++)
+  {
+    const char* headerValue = headerName + strlen(headerName) + 1;
+    uint16_t valueLen = strlen(headerValue);
+    int index = _findHeader(headerName);
+
+    if (index >= 0)
+    {
+      _headerSlices[index].start  = headerValue - conn.buf;
+      _headerSlices[index].length = valueLen;
+    }
+
+    if (strcasecmp(headerName, "Host") == 0)
+    {
+      _hostHeader = headerValue;
+    }
+    else if ( (strcasecmp(headerName, "Range") == 0) && !parseRange(headerValue, _rangeFirst, _rangeLast) )
+    {
+      _rangeFirst = HTTP_RANGE_NONE;
+      _rangeLast  = HTTP_RANGE_NONE;
+    }
+    else if (strcasecmp(headerName, "If-Range") == 0)
+    {
+      _ifRange = headerValue;
+    }
+    else if (strcasecmp(headerName, "If-None-Match") == 0)
+    {
+      _ifNoneMatch = headerValue;
+    }
+
+    headerName = headerValue + valueLen + 1;
+  }
+
+  // The query is decoded in place in conn.buf
+  char*   query     = conn.buf + conn.queryStart;
+  size_t  queryLen  = conn.queryStart ? strlen(query) : 0;
+
+  ET_LOGDEBUG1(F("method: "), _currentMethod);
+  ET_LOGDEBUG1(F("url: "), _currentUri);
+  ET_LOGDEBUG1(F("search: "), conn.queryStart ? query : "");
+
+  //attach handler
+  _currentHandler = _findHandler();
+
+  // below is needed only when POST type request
+  if (_currentMethod == HTTP_POST || _currentMethod == HTTP_PUT || _currentMethod == HTTP_PATCH
+      || _currentMethod == HTTP_DELETE)
+  {
+    if (conn.flags & HPF_MULTIPART)
+    {
+      String boundaryStr = conn.buf + conn.boundaryStart;
+      boundaryStr.replace("\"", "");
+
+      _parseArguments(query, queryLen);
+
+      // here: content is not yet read
+      ethernetConnectionStream stream(conn, conn.contentLength);
+
+      stream.setTimeout(HTTP_MAX_POST_WAIT);
+
+      if (!_parseForm(stream, boundaryStr, conn.contentLength))
+      {
+        return false;
+      }
+
+      // Skip any epilogue after the closing boundary, the next pipelined request follows it
+      uint8_t skipBuf[32];
+
+      while ( stream.remaining()
+              && stream.readBytes(skipBuf, (stream.remaining() < sizeof(skipBuf)) ? stream.remaining() : sizeof(skipBuf)) )
+        ;
+    }
+    else
+    {
+      if (conn.flags & HPF_FORM_ENCODED)
+      {
+        // query and body in one copy, the body is kept undecoded for "plain"
+        String searchStr;
+
+        searchStr.reserve(queryLen + 1 + conn.body.length());
+
+        if (queryLen)
+        {
+          searchStr += query;
+          searchStr += '&';
+        }
+
+        searchStr += conn.body;
 
-    if (data.length() + avail > maxLength)
-      avail = maxLength - data.length();
+        // parse searchStr for key/value pairs
+        _parseArguments(&searchStr[0], searchStr.length());
+      }
+      else
+      {
+        _parseArguments(query, queryLen);
+      }
+
+      if (conn.flags & HPF_STREAM_BODY)
+      {
+        // "plain" is added by _readPlainBody() if the handler asks for it
+        _bodyRemaining = conn.contentLength;
+      }
+      else if (conn.contentLength)
+      {
+        // add key=value: plain={body} (post json or other data)
+        RequestArgument& arg = _currentArgs[_currentArgCount++];
+        arg.key   = F("plain");
+        arg.value = static_cast<String&&>(conn.body);
+      }
+    }
+  }
+  else
+  {
+    _parseArguments(query, queryLen);
 
-    while (avail--)
-      data += (char)client.read();
+    if (conn.flags & (HPF_STREAM_BODY | HPF_MULTIPART))
+    {
+      // Body left in the socket by the parser, drained after the handler so the next
+      // pipelined request starts after it
+      _bodyRemaining = conn.contentLength;
+    }
+  }
+
+  conn.body = String();
+
+  ET_LOGDEBUG1(F("Request:"), _currentUri);
+  ET_LOGDEBUG (F("Final list of key/value pairs:"));
+
+  for (int i = 0; i < _currentArgCount; i++)
+  {
+    ET_LOGDEBUG1("key:",   _currentArgs[i].key.c_str());
+    ET_LOGDEBUG1("value:", _currentArgs[i].value.c_str());
   }
 
-  return data.length() == maxLength;
+  return true;
 }
 
 ////////////////////////////////////////
 
-#else
+#else    // #if USE_NEW_WEBSERVER_VERSION
 
 ////////////////////////////////////////
 
@@ -138,10 +924,6 @@ static char* readBytesWithTimeout(EthernetClient& client, size_t maxLength, size
 
 ////////////////////////////////////////
 
-#endif    // #if USE_NEW_WEBSERVER_VERSION
-
-////////////////////////////////////////
-
 bool EthernetWebServer::_parseRequest(EthernetClient& client)
 {
   // Read the first line of HTTP request
@@ -170,6 +952,11 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
   String url        = req.substring(addr_start + 1, addr_end);
   String versionEnd = req.substring(addr_end + 8);
   _currentVersion   = atoi(versionEnd.c_str());
+  _acceptEncoding   = 0;
+  _rangeFirst       = HTTP_RANGE_NONE;
+  _rangeLast        = HTTP_RANGE_NONE;
+  _ifRange          = nullptr;
+  _ifNoneMatch      = String();
   String searchStr  = "";
   int hasSearch     = url.indexOf('?');
 
@@ -184,36 +971,6 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
 
   HTTPMethod method = HTTP_GET;
 
-  // KH
-#if USE_NEW_WEBSERVER_VERSION
-
-  if (methodStr == "HEAD")
-  {
-    method = HTTP_HEAD;
-  }
-  else if (methodStr == "POST")
-  {
-    method = HTTP_POST;
-  }
-  else if (methodStr == "DELETE")
-  {
-    method = HTTP_DELETE;
-  }
-  else if (methodStr == "OPTIONS")
-  {
-    method = HTTP_OPTIONS;
-  }
-  else if (methodStr == "PUT")
-  {
-    method = HTTP_PUT;
-  }
-  else if (methodStr == "PATCH")
-  {
-    method = HTTP_PATCH;
-  }
-
-#else    // #if USE_NEW_WEBSERVER_VERSION
-
   if (methodStr == "POST")
   {
     method = HTTP_POST;
@@ -236,8 +993,6 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
     method = HTTP_PATCH;
   }
 
-#endif    // #if USE_NEW_WEBSERVER_VERSION
-
   _currentMethod = method;
 
   ET_LOGDEBUG1(F("method: "), methodStr);
@@ -245,15 +1000,7 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
   ET_LOGDEBUG1(F("search: "), searchStr);
 
   //attach handler
-  ethernetRequestHandler* handler;
-
-  for (handler = _firstHandler; handler; handler = handler->next())
-  {
-    if (handler->canHandle(_currentMethod, _currentUri))
-      break;
-  }
-
-  _currentHandler = handler;
+  _currentHandler = _findHandler();
 
   String formData;
 
@@ -264,10 +1011,6 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
     String headerName;
     String headerValue;
 
-#if USE_NEW_WEBSERVER_VERSION
-    bool isEncoded  = false;
-#endif
-
     bool isForm     = false;
     uint32_t contentLength = 0;
 
@@ -300,16 +1043,13 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
       {
         using namespace mime;
 
-        if (headerValue.startsWith(mimeTable[txt].mimeType))
+        if (headerValue.startsWith(mime::contentType(txt)))
         {
           isForm = false;
         }
         else if (headerValue.startsWith("application/x-www-form-urlencoded"))
         {
           isForm = false;
-#if USE_NEW_WEBSERVER_VERSION
-          isEncoded = true;
-#endif
         }
         else if (headerValue.startsWith("multipart/"))
         {
@@ -317,123 +1057,34 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
           boundaryStr.replace("\"", "");
           isForm = true;
         }
-      }
-      else if (headerName.equalsIgnoreCase("Content-Length"))
-      {
-        _clientContentLength = contentLength = headerValue.toInt();
-      }
-      else if (headerName.equalsIgnoreCase("Host"))
-      {
-        _hostHeader = headerValue;
-      }
-    }
-
-    //KH
-#if USE_NEW_WEBSERVER_VERSION
-
-    ////////////////////////////////////////
-
-    String plainBuf;
-
-    if ( !isForm
-         && // read content into plainBuf
-         (   !readBytesWithTimeout(client, contentLength, plainBuf, HTTP_MAX_POST_WAIT)
-             || (plainBuf.length() < contentLength)
-         )
-       )
-    {
-      return false;
-    }
-
-    if (isEncoded)
-    {
-      // isEncoded => !isForm => plainBuf is not empty
-      // add plainBuf in search str
-      if (searchStr.length())
-        searchStr += '&';
-
-      searchStr += plainBuf;
-    }
-
-    // parse searchStr for key/value pairs
-    _parseArguments(searchStr);
-
-    if (!isForm)
-    {
-      if (contentLength)
-      {
-        // add key=value: plain={body} (post json or other data)
-        RequestArgument& arg = _currentArgs[_currentArgCount++];
-        arg.key   = F("plain");
-        arg.value = plainBuf;
-      }
-    }
-    else
-    {
-      // isForm is true
-      // here: content is not yet read (plainBuf is still empty)
-      if (!_parseForm(client, boundaryStr, contentLength))
-      {
-        return false;
-      }
-    }
-  }
-  else
-  {
-    String headerName;
-    String headerValue;
-
-    //parse headers
-    while (1)
-    {
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
-
-      if (req == "")
-        break;//no more headers
-
-      int headerDiv = req.indexOf(':');
-
-      if (headerDiv == -1)
-      {
-        break;
-      }
-
-      headerName  = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 2);
-      _collectHeader(headerName.c_str(), headerValue.c_str());
-
-      ET_LOGDEBUG1(F("headerName:"), headerName);
-      ET_LOGDEBUG1(F("headerValue:"), headerValue);
-
-      if (headerName.equalsIgnoreCase(F("Host")))
-      {
-        _hostHeader = headerValue;
-      }
-    }
-
-    _parseArguments(searchStr);
-  }
-
-  client.flush();
-
-  ET_LOGDEBUG1(F("Request:"), url);
-  ET_LOGDEBUG1(F("Arguments:"), searchStr);
-  ET_LOGDEBUG (F("Final list of key/value pairs:"));
-
-  for (int i = 0; i < _currentArgCount; i++)
-  {
-    ET_LOGDEBUG1("key:",   _currentArgs[i].key.c_str());
-    ET_LOGDEBUG1("value:", _currentArgs[i].value.c_str());
-  }
-
-  return true;
-
-  ////////////////////////////////////////
-
-#else   // #if USE_NEW_WEBSERVER_VERSION
-
-    ////////////////////////////////////////
+      }
+      else if (headerName.equalsIgnoreCase("Content-Length"))
+      {
+        _clientContentLength = contentLength = headerValue.toInt();
+      }
+      else if (headerName.equalsIgnoreCase("Host"))
+      {
+        _hostHeader = headerValue;
+      }
+      else if (headerName.equalsIgnoreCase("Accept-Encoding"))
+      {
+        _acceptEncoding = parseAcceptEncoding(headerValue.c_str());
+      }
+      else if ( headerName.equalsIgnoreCase("Range") && !parseRange(headerValue.c_str(), _rangeFirst, _rangeLast) )
+      {
+        _rangeFirst = HTTP_RANGE_NONE;
+        _rangeLast  = HTTP_RANGE_NONE;
+      }
+      else if (headerName.equalsIgnoreCase("If-Range"))
+      {
+        // The value isn't kept here, so the validator never matches and the whole body is sent
+        _ifRange = "";
+      }
+      else if (headerName.equalsIgnoreCase("If-None-Match"))
+      {
+        _ifNoneMatch = headerValue;
+      }
+    }
 
     if (isForm)
     {
@@ -477,6 +1128,24 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
       {
         _hostHeader = headerValue;
       }
+      else if (headerName.equalsIgnoreCase("Accept-Encoding"))
+      {
+        _acceptEncoding = parseAcceptEncoding(headerValue.c_str());
+      }
+      else if ( headerName.equalsIgnoreCase("Range") && !parseRange(headerValue.c_str(), _rangeFirst, _rangeLast) )
+      {
+        _rangeFirst = HTTP_RANGE_NONE;
+        _rangeLast  = HTTP_RANGE_NONE;
+      }
+      else if (headerName.equalsIgnoreCase("If-Range"))
+      {
+        // The value isn't kept here, so the validator never matches and the whole body is sent
+        _ifRange = "";
+      }
+      else if (headerName.equalsIgnoreCase("If-None-Match"))
+      {
+        _ifNoneMatch = headerValue;
+      }
     }
 
     _parseArguments(searchStr);
@@ -488,8 +1157,6 @@ bool EthernetWebServer::_parseRequest(EthernetClient& client)
   ET_LOGDEBUG1(F("Arguments: "), searchStr);
 
   return true;
-
-#endif
 }
 
 ////////////////////////////////////////
@@ -511,167 +1178,89 @@ bool EthernetWebServer::_collectHeader(const char* headerName, const char* heade
 
 ////////////////////////////////////////
 
-#if USE_NEW_WEBSERVER_VERSION
+#endif    // #if USE_NEW_WEBSERVER_VERSION
 
 ////////////////////////////////////////
 
-struct storeArgHandler
-{
-  void operator() (String& key, String& value, const String& data, int equal_index, int pos, int key_end_pos,
-                   int next_index)
-  {
-    key = EthernetWebServer::urlDecode(data.substring(pos, key_end_pos));
-
-    if ((equal_index != -1) && ((equal_index < next_index - 1) || (next_index == -1)))
-      value = EthernetWebServer::urlDecode(data.substring(equal_index + 1, next_index));
-  }
-};
+#if USE_NEW_WEBSERVER_VERSION
 
 ////////////////////////////////////////
 
-void EthernetWebServer::_parseArguments(const String& data)
+// Split "key=value&key=value" into _currentArgs in a single pass, url-decoding each key and value
+// in place in data, which must have room for len + 1 chars. One spare argument is left for "plain"
+void EthernetWebServer::_parseArguments(char* data, size_t len)
 {
   if (_currentArgs)
     delete[] _currentArgs;
 
-  _currentArgs = 0;
-
-  if (data.length() == 0)
-  {
-    _currentArgCount = 0;
-    _currentArgs = new RequestArgument[1];
-
-    return;
-  }
+  _currentArgs      = 0;
+  _currentArgCount  = 0;
 
-  _currentArgCount = 1;
+  int maxArgs = len ? 1 : 0;
 
-  for (int i = 0; i < (int)data.length(); )
-  {
-    i = data.indexOf('&', i);
+  for (const char* amp = data; (amp = (const char*) memchr(amp, '&', data + len - amp)); amp++)
+    maxArgs++;
 
-    if (i == -1)
-      break;
+  _currentArgs        = new RequestArgument[maxArgs + 1];
+  _currentArgCapacity = maxArgs + 1;
 
-    ++i;
-    ++_currentArgCount;
-  }
+  char* end = data + len;
+  char* pos = data;
 
-  _currentArgs = new RequestArgument[_currentArgCount + 1];
+  while (pos < end)
+  {
+    char* next  = (char*) memchr(pos, '&', end - pos);
 
-  int pos = 0;
-  int iarg;
+    if (!next)
+      next = end;
 
-  for (iarg = 0; iarg < _currentArgCount;)
-  {
-    int equal_sign_index = data.indexOf('=', pos);
-    int next_arg_index = data.indexOf('&', pos);
+    char* equal = (char*) memchr(pos, '=', next - pos);
 
-    if ((equal_sign_index == -1) || ((equal_sign_index > next_arg_index) && (next_arg_index != -1)))
+    // pairs without '=' are skipped
+    if (equal)
     {
-      if (next_arg_index == -1)
-        break;
+      RequestArgument& arg = _currentArgs[_currentArgCount++];
 
-      pos = next_arg_index + 1;
+      urlDecode(pos, equal - pos);
+      arg.key = pos;
 
-      continue;
+      urlDecode(equal + 1, next - equal - 1);
+      arg.value = equal + 1;
     }
 
-    RequestArgument& arg = _currentArgs[iarg];
-    arg.key = urlDecode(data.substring(pos, equal_sign_index));
-    arg.value = urlDecode(data.substring(equal_sign_index + 1, next_arg_index));
-
-    ++iarg;
-
-    if (next_arg_index == -1)
-      break;
-
-    pos = next_arg_index + 1;
-  }
-
-  _currentArgCount = iarg;
-}
-
-////////////////////////////////////////
-
-void EthernetWebServer::_uploadWriteByte(uint8_t b)
-{
-  if (_currentUpload->currentSize == HTTP_UPLOAD_BUFLEN)
-  {
-    if (_currentHandler && _currentHandler->canUpload(_currentUri))
-      _currentHandler->upload(*this, _currentUri, *_currentUpload);
-
-    _currentUpload->totalSize += _currentUpload->currentSize;
-    _currentUpload->currentSize = 0;
+    pos = next + 1;
   }
-
-  _currentUpload->buf[_currentUpload->currentSize++] = b;
 }
 
 ////////////////////////////////////////
 
-#if 1
-
-uint8_t EthernetWebServer::_uploadReadByte(EthernetClient& client)
-{
-  int res = client.read();
-
-  if (res == -1)
-  {
-    while (!client.available() && client.connected())
-      yield();
-
-    res = client.read();
-  }
-
-  return (uint8_t)res;
-}
-
-#else
-
-uint8_t EthernetWebServer::_uploadReadByte(EthernetClient& client)
+// Append len bytes of file data to the upload buffer, passing it to the upload handler each time it fills up
+void EthernetWebServer::_uploadWriteBlock(const uint8_t* data, size_t len)
 {
-  int res = client.read();
-
-  if (res < 0)
+  while (len)
   {
-    // keep trying until you either read a valid byte or timeout
-    unsigned long startMillis = millis();
-    unsigned long timeoutIntervalMillis = client.getTimeout();
-    bool timedOut = false;
-
-    for (;;)
+    if (_currentUpload->currentSize == HTTP_UPLOAD_BUFLEN)
     {
-      if (!client.connected())
-        return -1;
+      if (_currentHandler && _currentHandler->canUpload(_currentUri))
+        _currentHandler->upload(*this, _currentUri, *_currentUpload);
 
-      // loosely modeled after blinkWithoutDelay pattern
-      while (!timedOut && !client.available() && client.connected())
-      {
-        delay(2);
-        timedOut = (millis() - startMillis) >= timeoutIntervalMillis;
-      }
+      _currentUpload->totalSize += _currentUpload->currentSize;
+      _currentUpload->currentSize = 0;
+    }
 
-      res = client.read();
+    size_t size = HTTP_UPLOAD_BUFLEN - _currentUpload->currentSize;
 
-      if (res >= 0)
-      {
-        return res; // exit on a valid read
-      }
+    if (size > len)
+      size = len;
 
-      timedOut = (millis() - startMillis) >= timeoutIntervalMillis;
+    memcpy(_currentUpload->buf + _currentUpload->currentSize, data, size);
 
-      if (timedOut)
-      {
-        return res; // exit on a timeout
-      }
-    }
+    _currentUpload->currentSize += size;
+    data  += size;
+    len   -= size;
   }
-
-  return res;
 }
 
-#endif
 ////////////////////////////////////////
 
 #else   // #if USE_NEW_WEBSERVER_VERSION
@@ -800,7 +1389,7 @@ uint8_t EthernetWebServer::_uploadReadByte(EthernetClient& client)
 
 ////////////////////////////////////////
 
-bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundary, uint32_t len)
+bool EthernetWebServer::_parseForm(ethernetConnectionStream& client, const String& boundary, uint32_t len)
 {
   (void) len;
 
@@ -839,6 +1428,14 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
       line = client.readStringUntil('\r');
       client.readStringUntil('\n');
 
+      // The body ended, or the client left, before the closing boundary
+      if ( (line.length() == 0) && !client.connected() )
+      {
+        ET_LOGDEBUG(F("_parseForm: Truncated body"));
+
+        return false;
+      }
+
       if (line.length() > 19 && line.substring(0, 19).equalsIgnoreCase(F("Content-Disposition")))
       {
         int nameStart = line.indexOf('=');
@@ -869,7 +1466,7 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
 
           using namespace mime;
 
-          argType = mimeTable[txt].mimeType;
+          argType = mime::contentType(txt);
           line    = client.readStringUntil('\r');
           client.readStringUntil('\n');
 
@@ -893,6 +1490,13 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
               if (line.startsWith("--" + boundary))
                 break;
 
+              if ( (line.length() == 0) && !client.connected() )
+              {
+                ET_LOGDEBUG(F("_parseForm: Truncated body"));
+
+                return false;
+              }
+
               if (argValue.length() > 0)
                 argValue += "\n";
 
@@ -933,112 +1537,77 @@ bool EthernetWebServer::_parseForm(EthernetClient& client, const String& boundar
               _currentHandler->upload(*this, _currentUri, *_currentUpload);
 
             _currentUpload->status = UPLOAD_FILE_WRITE;
-            uint8_t argByte = _uploadReadByte(client);
 
-readfile:
+            // File data ends at "\r\n--boundary". Copy everything before the next '\r' as one block,
+            // and only compare the delimiter at a '\r'
+            String delimiter = "\r\n--" + boundary;
 
-            while (argByte != 0x0D)
+            if (delimiter.length() > HTTP_RX_BUFLEN)
             {
-              if (!client.connected())
-                return _parseFormUploadAborted();
-
-              _uploadWriteByte(argByte);
-              argByte = _uploadReadByte(client);
-            }
-
-            argByte = _uploadReadByte(client);
+              ET_LOGERROR1(F("_parseForm: Boundary longer than HTTP_RX_BUFLEN:"), boundary);
 
-            if (!client.connected())
               return _parseFormUploadAborted();
+            }
 
-            if (argByte == 0x0A)
+            while (1)
             {
-              argByte = _uploadReadByte(client);
+              size_t avail;
+              const uint8_t* data = client.peekBlock(avail);
 
-              if (!client.connected())
+              if (!data)
                 return _parseFormUploadAborted();
 
-              if ((char)argByte != '-')
-              {
-                //continue reading the file
-                _uploadWriteByte(0x0D);
-                _uploadWriteByte(0x0A);
-                goto readfile;
-              }
-              else
+              const uint8_t* cr = (const uint8_t*) memchr(data, '\r', avail);
+
+              if (cr != data)
               {
-                argByte = _uploadReadByte(client);
+                size_t size = cr ? (size_t) (cr - data) : avail;
 
-                if (!client.connected())
-                  return _parseFormUploadAborted();
+                _uploadWriteBlock(data, size);
+                client.skip(size);
 
-                if ((char)argByte != '-')
-                {
-                  //continue reading the file
-                  _uploadWriteByte(0x0D);
-                  _uploadWriteByte(0x0A);
-                  _uploadWriteByte((uint8_t)('-'));
-                  goto readfile;
-                }
+                continue;
               }
 
-              // Better compiler warning than risk of fragmented heap
-              uint8_t endBuf[boundary.length()];
+              if (!client.require(delimiter.length()))
+                return _parseFormUploadAborted();
 
-              client.readBytes(endBuf, boundary.length());
+              data = client.peekBlock(avail);
 
-              if (strstr((const char*)endBuf, boundary.c_str()) != NULL)
+              if (!memcmp(data, delimiter.c_str(), delimiter.length()))
               {
-                if (_currentHandler && _currentHandler->canUpload(_currentUri))
-                  _currentHandler->upload(*this, _currentUri, *_currentUpload);
-
-                _currentUpload->totalSize += _currentUpload->currentSize;
-                _currentUpload->status = UPLOAD_FILE_END;
-
-                if (_currentHandler && _currentHandler->canUpload(_currentUri))
-                  _currentHandler->upload(*this, _currentUri, *_currentUpload);
+                client.skip(delimiter.length());
 
-                ET_LOGDEBUG1(F("End File: "), _currentUpload->filename);
-                ET_LOGDEBUG1(F("Type: "), _currentUpload->type);
-                ET_LOGDEBUG1(F("Size: "), _currentUpload->totalSize);
+                break;
+              }
 
-                line = client.readStringUntil(0x0D);
-                client.readStringUntil(0x0A);
+              // A '\r' of the file data
+              _uploadWriteBlock(data, 1);
+              client.skip(1);
+            }
 
-                if (line == "--")
-                {
-                  ET_LOGDEBUG(F("Done Parsing POST"));
+            if (_currentHandler && _currentHandler->canUpload(_currentUri))
+              _currentHandler->upload(*this, _currentUri, *_currentUpload);
 
-                  break;
-                }
+            _currentUpload->totalSize += _currentUpload->currentSize;
+            _currentUpload->status = UPLOAD_FILE_END;
 
-                continue;
-              }
-              else
-              {
-                _uploadWriteByte(0x0D);
-                _uploadWriteByte(0x0A);
-                _uploadWriteByte((uint8_t)('-'));
-                _uploadWriteByte((uint8_t)('-'));
+            if (_currentHandler && _currentHandler->canUpload(_currentUri))
+              _currentHandler->upload(*this, _currentUri, *_currentUpload);
 
-                uint32_t i = 0;
+            ET_LOGDEBUG1(F("End File: "), _currentUpload->filename);
+            ET_LOGDEBUG1(F("Type: "), _currentUpload->type);
+            ET_LOGDEBUG1(F("Size: "), _currentUpload->totalSize);
 
-                while (i < boundary.length())
-                {
-                  _uploadWriteByte(endBuf[i++]);
-                }
+            line = client.readStringUntil(0x0D);
+            client.readStringUntil(0x0A);
 
-                argByte = _uploadReadByte(client);
-                goto readfile;
-              }
-            }
-            else
+            if (line == "--")
             {
-              _uploadWriteByte(0x0D);
-              goto readfile;
-            }
+              ET_LOGDEBUG(F("Done Parsing POST"));
 
-            break;
+              break;
+            }
           }
         }
       }
@@ -1058,7 +1627,8 @@ readfile:
     if (_currentArgs)
       delete[] _currentArgs;
 
-    _currentArgs = new RequestArgument[_postArgsLen];
+    _currentArgs        = new RequestArgument[_postArgsLen];
+    _currentArgCapacity = _postArgsLen;
 
     if (_currentArgs == nullptr)
     {
@@ -1403,38 +1973,113 @@ bool EthernetWebServer::_parseFormUploadAborted()
 
 ////////////////////////////////////////
 
-String EthernetWebServer::urlDecode(const String& text)
+#if !( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
+
+// True if any byte of word is c, "Determine if a word has a byte equal to n" from Bit Twiddling Hacks
+static inline bool wordHasByte(uint32_t word, uint8_t c)
+{
+  uint32_t x = word ^ (0x01010101UL * c);
+
+  return ((x - 0x01010101UL) & ~x & 0x80808080UL) != 0;
+}
+
+#endif
+
+////////////////////////////////////////
+
+static inline int hexDigitValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+
+  c |= 0x20;
+
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+
+  return -1;
+}
+
+////////////////////////////////////////
+
+// Decode "%XX" and '+' of text[0..len) in place, the output is never longer than the input.
+// Writes a terminating 0 at text[newLen], so text must have room for len + 1 chars. Returns newLen
+size_t EthernetWebServer::urlDecode(char* text, size_t len)
 {
-  String decoded    = "";
-  char temp[]       = "0x00";
-  unsigned int len  = text.length();
-  unsigned int i    = 0;
+  size_t in   = 0;
+  size_t out  = 0;
 
-  while (i < len)
+  while (in < len)
   {
-    char decodedChar;
-    char encodedChar = text.charAt(i++);
+    size_t run = in;
+
+#if !( ETHERNET_USE_AVR_MEGA || ETHERNET_USE_MEGA_AVR || ETHERNET_USE_DXCORE )
 
-    if ((encodedChar == '%') && (i + 1 < len))
+    // Skip runs without '%' or '+' a word at a time
+    while (run + 4 <= len)
     {
-      temp[2] = text.charAt(i++);
-      temp[3] = text.charAt(i++);
+      uint32_t word;
+
+      memcpy(&word, text + run, 4);
+
+      if (wordHasByte(word, '%') || wordHasByte(word, '+'))
+        break;
+
+      run += 4;
+    }
+
+#endif
+
+    while ( (run < len) && (text[run] != '%') && (text[run] != '+') )
+      run++;
 
-      decodedChar = strtol(temp, NULL, 16);
+    // Plain chars only have to be moved down once something was decoded before them
+    if (out != in)
+      memmove(text + out, text + in, run - in);
+
+    out += run - in;
+    in   = run;
+
+    if (in >= len)
+      break;
+
+    if (text[in] == '+')
+    {
+      text[out++] = ' ';
+      in++;
     }
     else
     {
-      if (encodedChar == '+')
+      int high  = (in + 2 < len) ? hexDigitValue(text[in + 1]) : -1;
+      int low   = (high >= 0) ? hexDigitValue(text[in + 2]) : -1;
+
+      if (low >= 0)
       {
-        decodedChar = ' ';
+        text[out++] = (char) ((high << 4) | low);
+        in += 3;
       }
       else
       {
-        decodedChar = encodedChar;  // normal ascii char
+        // Not an escape, keep the '%'
+        text[out++] = text[in++];
       }
     }
+  }
+
+  text[out] = 0;
 
-    decoded += decodedChar;
+  return out;
+}
+
+////////////////////////////////////////
+
+String EthernetWebServer::urlDecode(const String& text)
+{
+  String decoded = text;
+
+  if (decoded.length())
+  {
+    decoded.remove(urlDecode(&decoded[0], decoded.length()));
   }
 
   return decoded;
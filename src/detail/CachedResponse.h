@@ -0,0 +1,95 @@
+/****************************************************************************************************************************
+  CachedResponse.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef CACHED_RESPONSE_H
+#define CACHED_RESPONSE_H
+
+#include "RouteTree.h"
+
+////////////////////////////////////////
+
+// Handler registered by EthernetWebServer::onStatic(). The status line, the fixed headers and, unless it
+// stays in flash, the content are serialized once into one block. Only the HTTP version and the
+// connection headers are written per request. HEAD gets the same headers without the content
+class ethernetCachedResponseHandler : public ethernetRouteHandler
+{
+  public:
+
+    ethernetCachedResponseHandler(int code, const char* content_type, PGM_P content, size_t contentLength,
+                                  bool contentInFlash)
+      : ethernetRouteHandler(EthernetWebServer::THandlerFunction(), EthernetWebServer::THandlerFunction(), HTTP_GET)
+      , _contentLength(contentLength)
+      , _contentInFlash(contentInFlash)
+    {
+      _methods |= methodMask(HTTP_HEAD);
+
+      String head = " ";
+
+      head += String(code);
+      head += " ";
+      head += EthernetWebServer::_responseCodeToString(code);
+      head += RETURN_NEWLINE;
+      head += "Content-Type: ";
+      head += content_type;
+      head += RETURN_NEWLINE;
+      head += "Content-Length: ";
+      head += String(contentLength);
+      head += RETURN_NEWLINE;
+
+      _headLen  = head.length();
+      _response = new char[_headLen + (contentInFlash ? 0 : contentLength)];
+
+      memcpy(_response, head.c_str(), _headLen);
+
+      if (contentInFlash)
+      {
+        _content = content;
+      }
+      else
+      {
+        memcpy(_response + _headLen, content, contentLength);
+        _content = _response + _headLen;
+      }
+    }
+
+    ~ethernetCachedResponseHandler()
+    {
+      delete[] _response;
+    }
+
+    bool canUpload(const String& requestUri) override
+    {
+      ETW_UNUSED(requestUri);
+
+      return false;
+    }
+
+    bool handle(EthernetWebServer& server, const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      if (!canHandle(requestMethod, requestUri))
+        return false;
+
+      server._sendCached(_response, _headLen, _content, (requestMethod == HTTP_HEAD) ? 0 : _contentLength,
+                         _contentInFlash);
+      return true;
+    }
+
+  protected:
+    char*       _response;
+    size_t      _headLen;
+    PGM_P       _content;
+    size_t      _contentLength;
+    bool        _contentInFlash;
+};
+
+#endif  // CACHED_RESPONSE_H
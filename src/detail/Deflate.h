@@ -0,0 +1,341 @@
+/****************************************************************************************************************************
+  Deflate.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#if (HTTP_DEFLATE_WINDOW > 0)
+
+////////////////////////////////////////
+
+#define DEFLATE_MIN_MATCH       3
+#define DEFLATE_MAX_MATCH       258
+#define DEFLATE_NIL             0xFFFF
+
+static const uint16_t deflateLengthBase[29] =
+{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t deflateLengthExtra[29] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t deflateDistBase[30] =
+{
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+  4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t deflateDistExtra[30] =
+{
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// CRC-32 of gzip, 4 bits at a time
+static const uint32_t deflateCrcTable[16] =
+{
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+////////////////////////////////////////
+
+// Streaming compressor for responses of unknown length, see EthernetWebServer::enableCompression().
+// LZ77 over a window of HTTP_DEFLATE_WINDOW bytes with a single hash candidate per position, coded
+// with the fixed Huffman tables of RFC 1951, so there is no block to buffer and no tree to build.
+// Output is wrapped as gzip (RFC 1952) or zlib (RFC 1950, "Content-Encoding: deflate") and handed
+// to the server in HTTP_DEFLATE_OUTBUF pieces, one chunk each
+class ethernetDeflate
+{
+  public:
+
+    explicit ethernetDeflate(EthernetWebServer& server)
+      : _server(server)
+    {
+    }
+
+    void begin(bool gzip)
+    {
+      _gzip     = gzip;
+      _pos      = 0;
+      _end      = 0;
+      _outLen   = 0;
+      _bitBuf   = 0;
+      _bitCount = 0;
+      _check    = gzip ? 0 : 1;
+      _size     = 0;
+
+      memset(_head, 0xFF, sizeof(_head));
+
+      if (gzip)
+      {
+        static const uint8_t header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+
+        for (uint8_t i = 0; i < sizeof(header); i++)
+          _putByte(header[i]);
+      }
+      else
+      {
+        _putByte(0x78);
+        _putByte(0x01);
+      }
+
+      // Not the last block, fixed Huffman codes
+      _putBits(0, 1);
+      _putBits(1, 2);
+    }
+
+    void write(const uint8_t* data, size_t len)
+    {
+      while (len)
+      {
+        if (_end == sizeof(_buf))
+          _slide();
+
+        size_t size = sizeof(_buf) - _end;
+
+        if (size > len)
+          size = len;
+
+        memcpy(_buf + _end, data, size);
+        _update(_buf + _end, size);
+
+        _end += size;
+        data += size;
+        len  -= size;
+
+        _deflate(false);
+      }
+    }
+
+    // Code what is left, end the stream and hand over everything
+    void finish()
+    {
+      _deflate(true);
+      _putSymbol(256);
+
+      // Empty last block
+      _putBits(1, 1);
+      _putBits(1, 2);
+      _putSymbol(256);
+
+      if (_bitCount)
+        _putBits(0, 8 - _bitCount);
+
+      if (_gzip)
+      {
+        for (uint8_t i = 0; i < 32; i += 8)
+          _putByte(_check >> i);
+
+        for (uint8_t i = 0; i < 32; i += 8)
+          _putByte(_size >> i);
+      }
+      else
+      {
+        for (int8_t i = 24; i >= 0; i -= 8)
+          _putByte(_check >> i);
+      }
+
+      if (_outLen)
+      {
+        _server._sendCompressed(_out, _outLen);
+        _outLen = 0;
+      }
+    }
+
+  private:
+
+    void _update(const uint8_t* data, size_t len)
+    {
+      _size += len;
+
+      if (_gzip)
+      {
+        uint32_t crc = ~_check;
+
+        while (len--)
+        {
+          crc ^= *data++;
+          crc = (crc >> 4) ^ deflateCrcTable[crc & 0x0F];
+          crc = (crc >> 4) ^ deflateCrcTable[crc & 0x0F];
+        }
+
+        _check = ~crc;
+      }
+      else
+      {
+        uint32_t a = _check & 0xFFFF;
+        uint32_t b = _check >> 16;
+
+        while (len--)
+        {
+          a = (a + *data++) % 65521;
+          b = (b + a) % 65521;
+        }
+
+        _check = (b << 16) | a;
+      }
+    }
+
+    // Drop the older half of the buffer, keeping HTTP_DEFLATE_WINDOW bytes of history
+    void _slide()
+    {
+      memmove(_buf, _buf + HTTP_DEFLATE_WINDOW, HTTP_DEFLATE_WINDOW);
+
+      _pos -= HTTP_DEFLATE_WINDOW;
+      _end -= HTTP_DEFLATE_WINDOW;
+
+      for (uint16_t i = 0; i < (1 << HTTP_DEFLATE_HASH_BITS); i++)
+        _head[i] = ( (_head[i] != DEFLATE_NIL) && (_head[i] >= HTTP_DEFLATE_WINDOW) ) ? _head[i] - HTTP_DEFLATE_WINDOW : DEFLATE_NIL;
+    }
+
+    uint16_t _hash(uint16_t pos) const
+    {
+      uint32_t key = ((uint32_t) _buf[pos] << 16) | ((uint32_t) _buf[pos + 1] << 8) | _buf[pos + 2];
+
+      return (uint32_t) (key * 2654435761UL) >> (32 - HTTP_DEFLATE_HASH_BITS);
+    }
+
+    // Code the buffered input, keeping DEFLATE_MAX_MATCH bytes of lookahead unless flushing
+    void _deflate(bool flush)
+    {
+      while ( (_pos < _end) && (flush || (_end - _pos >= DEFLATE_MAX_MATCH)) )
+      {
+        uint16_t length = 0;
+        uint16_t distance = 0;
+
+        if (_end - _pos >= DEFLATE_MIN_MATCH)
+        {
+          uint16_t h     = _hash(_pos);
+          uint16_t match = _head[h];
+
+          _head[h] = _pos;
+
+          if (match != DEFLATE_NIL)
+          {
+            uint16_t maxLength = (_end - _pos < DEFLATE_MAX_MATCH) ? _end - _pos : DEFLATE_MAX_MATCH;
+
+            while ( (length < maxLength) && (_buf[match + length] == _buf[_pos + length]) )
+              length++;
+
+            distance = _pos - match;
+          }
+        }
+
+        if (length >= DEFLATE_MIN_MATCH)
+        {
+          _putMatch(length, distance);
+
+          // Index the positions inside the match too, for the next matches
+          for (uint16_t i = 1; (i < length) && (_end - (_pos + i) >= DEFLATE_MIN_MATCH); i++)
+            _head[_hash(_pos + i)] = _pos + i;
+
+          _pos += length;
+        }
+        else
+        {
+          _putSymbol(_buf[_pos++]);
+        }
+      }
+    }
+
+    void _putMatch(uint16_t length, uint16_t distance)
+    {
+      uint8_t i = 28;
+
+      while (deflateLengthBase[i] > length)
+        i--;
+
+      _putSymbol(257 + i);
+      _putBits(length - deflateLengthBase[i], deflateLengthExtra[i]);
+
+      i = 29;
+
+      while (deflateDistBase[i] > distance)
+        i--;
+
+      // Fixed 5 bit distance codes
+      _putCode(i, 5);
+      _putBits(distance - deflateDistBase[i], deflateDistExtra[i]);
+    }
+
+    // Fixed literal/length code of RFC 1951 3.2.6
+    void _putSymbol(uint16_t symbol)
+    {
+      if (symbol < 144)
+        _putCode(0x30 + symbol, 8);
+      else if (symbol < 256)
+        _putCode(0x190 + symbol - 144, 9);
+      else if (symbol < 280)
+        _putCode(symbol - 256, 7);
+      else
+        _putCode(0xC0 + symbol - 280, 8);
+    }
+
+    // Huffman codes are packed starting with their most significant bit
+    void _putCode(uint16_t code, uint8_t bits)
+    {
+      uint16_t reversed = 0;
+
+      for (uint8_t i = 0; i < bits; i++)
+      {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+      }
+
+      _putBits(reversed, bits);
+    }
+
+    void _putBits(uint32_t value, uint8_t bits)
+    {
+      _bitBuf   |= value << _bitCount;
+      _bitCount += bits;
+
+      while (_bitCount >= 8)
+      {
+        _putByte(_bitBuf);
+        _bitBuf   >>= 8;
+        _bitCount -= 8;
+      }
+    }
+
+    void _putByte(uint8_t b)
+    {
+      _out[_outLen++] = b;
+
+      if (_outLen == sizeof(_out))
+      {
+        _server._sendCompressed(_out, _outLen);
+        _outLen = 0;
+      }
+    }
+
+    EthernetWebServer&  _server;
+    bool                _gzip;
+    uint16_t            _pos;         // next byte to code
+    uint16_t            _end;         // end of the buffered input
+    uint16_t            _outLen;
+    uint32_t            _bitBuf;
+    uint8_t             _bitCount;
+    uint32_t            _check;       // CRC-32 for gzip, Adler-32 for zlib
+    uint32_t            _size;
+    uint16_t            _head[1 << HTTP_DEFLATE_HASH_BITS];     // last position of each 3 byte hash
+    uint8_t             _buf[2 * HTTP_DEFLATE_WINDOW];
+    uint8_t             _out[HTTP_DEFLATE_OUTBUF];
+};
+
+#endif    // #if (HTTP_DEFLATE_WINDOW > 0)
+
+#endif  // DEFLATE_H
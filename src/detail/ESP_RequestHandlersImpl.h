@@ -40,6 +40,7 @@
 #include "WString.h"
 #include <MD5Builder.h>
 #include <base64.h>
+#include "ETagCache.h"
 
 
 class ethernetFunctionRequestHandler : public ethernetRequestHandler
@@ -63,14 +64,9 @@ class ethernetFunctionRequestHandler : public ethernetRequestHandler
       if (requestUri == _uri)
         return true;
 
-      if (_uri.endsWith("/*"))
-      {
-        String _uristart = _uri;
-        _uristart.replace("/*", "");
-
-        if (requestUri.startsWith(_uristart))
-          return true;
-      }
+      // "/path/*" matches anything starting with "/path", compared in place
+      if (_uri.endsWith("/*") && !strncmp(requestUri.c_str(), _uri.c_str(), _uri.length() - 2))
+        return true;
 
       return false;
     }
@@ -138,6 +134,63 @@ class StaticRequestHandler : public ethernetRequestHandler
     }
 
   protected:
+
+    // ETags of all the static handlers, computed on first request
+    static ethernetETagCache& _etagCache()
+    {
+      static ethernetETagCache cache;
+
+      return cache;
+    }
+
+    // Send the file at path, or its ".br" or ".gz" variant if the client accepts it. The ETag of the
+    // file is cached, so a revalidation costs opening the file to check it hasn't changed
+    bool _serveFile(EthernetWebServer& server, const String& path, bool hasBr, bool hasGz, bool negotiated)
+    {
+      String  variant = path;
+      uint8_t md5[16];
+
+      if (hasBr && server.acceptsEncoding(HTTP_ENCODING_BR))
+        variant += ".br";
+      else if (hasGz && server.acceptsEncoding(HTTP_ENCODING_GZIP))
+        variant += ".gz";
+
+      if (negotiated)
+        server.sendHeader("Vary", "Accept-Encoding");
+
+      File f = _fs.open(variant, "r");
+
+      if (!f || f.isDirectory())
+        return false;
+
+      _etagCache().get(_fs, variant, f, md5);
+
+      String etag = "\"" + base64::encode(md5, 16) + _etagSuffix(path, variant) + "\"";
+
+      if (server.ifNoneMatch(etag.c_str()))
+      {
+        server.sendHeader("ETag", etag);
+        server.send(304);
+        return true;
+      }
+
+      if (_cache_header.length() != 0)
+        server.sendHeader("Cache-Control", _cache_header);
+
+      server.sendHeader("ETag", etag);
+
+      server.streamFile(f, mime_esp::getContentType(path));
+      return true;
+    }
+
+    static const char* _etagSuffix(const String& path, const String& variant)
+    {
+      if (variant.length() == path.length())
+        return "";
+
+      return variant.endsWith(".br") ? "-br" : "-gz";
+    }
+
     FS _fs;
     bool _isFile;
     String _uri;
@@ -146,6 +199,7 @@ class StaticRequestHandler : public ethernetRequestHandler
     size_t _baseUriLength;
 };
 
+////////////////////////////////////////
 
 class StaticFileRequestHandler
   :
@@ -159,13 +213,9 @@ class StaticFileRequestHandler
       :
       StaticRequestHandler{fs, path, uri, cache_header}
     {
-      File f = SRH::_fs.open(path, "r");
-      MD5Builder calcMD5;
-      calcMD5.begin();
-      calcMD5.addStream(f, f.size());
-      calcMD5.calculate();
-      calcMD5.getBytes(_ETag_md5);
-      f.close();
+      // Precompressed variants served instead of the file to clients accepting them, looked up once
+      _hasBr = fs.exists(SRH::_path + ".br");
+      _hasGz = !SRH::_path.endsWith(".gz") && fs.exists(SRH::_path + ".gz");
     }
 
     bool canHandle(const HTTPMethod& requestMethod, const String& requestUri) override
@@ -175,40 +225,106 @@ class StaticFileRequestHandler
 
     bool handle(EthernetWebServer& server, const HTTPMethod& requestMethod, const String& requestUri)
     {
-      if (!canHandle(requestMethod, requestUri))
+      if (!canHandle(requestMethod, requestUri) || !_isFile)
         return false;
 
+      return _serveFile(server, SRH::_path, _hasBr, _hasGz, _hasBr || _hasGz);
+    }
 
-      const String etag = "\"" + base64::encode(_ETag_md5, 16) + "\"";
+  protected:
+    bool    _hasBr;
+    bool    _hasGz;
+};
 
-      if (server.header("If-None-Match") == etag)
-      {
-        server.send(304);
-        return true;
-      }
+////////////////////////////////////////
+
+// Serves the files under a directory, "index.html" for the directory itself. The precompressed
+// variants of the last HTTP_ETAG_CACHE_SIZE files served are remembered, not looked up on each request
+class StaticDirectoryRequestHandler
+  :
+  public StaticRequestHandler
+{
+    using SRH = StaticRequestHandler;
+    using WebServerType = EthernetWebServer;
+
+  public:
+    StaticDirectoryRequestHandler(FS& fs, const char* path, const char* uri, const char* cache_header)
+      :
+      StaticRequestHandler{fs, path, uri, cache_header}
+      , _nextVariants(0)
+    {
+      if (SRH::_path.endsWith("/"))
+        SRH::_path.remove(SRH::_path.length() - 1);
 
-      File f = SRH::_fs.open(SRH::_path, "r");
+      if (SRH::_uri.endsWith("/"))
+        _baseUriLength--;
+    }
 
-      if (!f)
+    bool canHandle(const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      if ( !SRH::validMethod(requestMethod) || !requestUri.startsWith(SRH::_uri.substring(0, _baseUriLength)) )
         return false;
 
-      if (!_isFile)
-      {
-        f.close();
+      // "/static" mounts "/static/..." but not "/statics"
+      return (requestUri.length() == _baseUriLength) || (requestUri[_baseUriLength] == '/');
+    }
+
+    bool handle(EthernetWebServer& server, const HTTPMethod& requestMethod, const String& requestUri)
+    {
+      if ( !canHandle(requestMethod, requestUri) || (requestUri.indexOf("..") >= 0) )
         return false;
-      }
 
-      if (SRH::_cache_header.length() != 0)
-        server.sendHeader("Cache-Control", SRH::_cache_header);
+      String path = SRH::_path + requestUri.substring(_baseUriLength);
 
-      server.sendHeader("ETag", etag);
+      if ( (requestUri.length() == _baseUriLength) || path.endsWith("/") )
+        path += path.endsWith("/") ? "index.html" : "/index.html";
 
-      server.streamFile(f, mime_esp::getContentType(SRH::_path), requestMethod);
-      return true;
+      uint8_t variants = _variants(path);
+
+      return _serveFile(server, path, variants & VARIANT_BR, variants & VARIANT_GZ, variants);
     }
 
   protected:
-    uint8_t _ETag_md5[16];
+
+    enum
+    {
+      VARIANT_BR = 1,
+      VARIANT_GZ = 2
+    };
+
+    // Precompressed variants of the file at path, looked up on its first request
+    uint8_t _variants(const String& path)
+    {
+      for (uint8_t i = 0; i < HTTP_ETAG_CACHE_SIZE; i++)
+      {
+        if (_knownVariants[i].path == path)
+          return _knownVariants[i].variants;
+      }
+
+      uint8_t variants = 0;
+
+      if (_fs.exists(path + ".br"))
+        variants |= VARIANT_BR;
+
+      if (!path.endsWith(".gz") && _fs.exists(path + ".gz"))
+        variants |= VARIANT_GZ;
+
+      _knownVariants[_nextVariants].path      = path;
+      _knownVariants[_nextVariants].variants  = variants;
+
+      _nextVariants = (_nextVariants + 1) % HTTP_ETAG_CACHE_SIZE;
+
+      return variants;
+    }
+
+    typedef struct
+    {
+      String    path;
+      uint8_t   variants;
+    } KnownVariants;
+
+    KnownVariants _knownVariants[HTTP_ETAG_CACHE_SIZE];
+    uint8_t       _nextVariants;
 };
 
 #endif  // ESP_REQUEST_HANDLER_IMPL_H
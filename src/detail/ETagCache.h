@@ -0,0 +1,198 @@
+/****************************************************************************************************************************
+  ETagCache.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef ETAG_CACHE_H
+#define ETAG_CACHE_H
+
+#include "FS.h"
+#include <MD5Builder.h>
+
+////////////////////////////////////////
+
+// MD5 digests of the files served by serveStatic(), computed the first time a file is requested rather than
+// when the handler is added. Up to HTTP_ETAG_CACHE_SIZE paths are kept, the oldest one is replaced first.
+// A digest is only used while the size and last write time of the file are unchanged, so the file is
+// still opened on each request to check them, even when the answer is 304.
+// With HTTP_ETAG_CACHE_FILE the digests are also kept in that file, one record per path rewritten in
+// place, so a reboot costs a lookup instead of reading each file again
+class ethernetETagCache
+{
+  public:
+
+    ethernetETagCache()
+      : _next(0)
+    {
+    }
+
+    // Digest of the open file at path, which is left at its start
+    void get(FS& fs, const String& path, File& file, uint8_t md5[16])
+    {
+      uint32_t size   = file.size();
+      uint32_t mtime  = (uint32_t) file.getLastWrite();
+      Entry*   entry  = nullptr;
+
+      for (uint8_t i = 0; i < HTTP_ETAG_CACHE_SIZE; i++)
+      {
+        if ( _entries[i].path.length() && (_entries[i].path == path) )
+        {
+          entry = &_entries[i];
+          break;
+        }
+      }
+
+      if ( entry && (entry->size == size) && (entry->mtime == mtime) )
+      {
+        memcpy(md5, entry->md5, 16);
+        return;
+      }
+
+      uint32_t hash = _hash(path);
+
+#if defined(HTTP_ETAG_CACHE_FILE)
+
+      if (!_load(fs, hash, size, mtime, md5))
+#endif
+      {
+        MD5Builder calcMD5;
+
+        calcMD5.begin();
+        calcMD5.addStream(file, size);
+        calcMD5.calculate();
+        calcMD5.getBytes(md5);
+
+        file.seek(0);
+
+#if defined(HTTP_ETAG_CACHE_FILE)
+        _store(fs, hash, size, mtime, md5);
+#endif
+      }
+
+      ETW_UNUSED(fs);
+      ETW_UNUSED(hash);
+
+      if (!entry)
+      {
+        // A file changed since it was cached keeps its entry
+        entry = &_entries[_next];
+        _next = (_next + 1) % HTTP_ETAG_CACHE_SIZE;
+      }
+
+      entry->path   = path;
+      entry->size   = size;
+      entry->mtime  = mtime;
+      memcpy(entry->md5, md5, 16);
+    }
+
+  protected:
+
+    // Record of HTTP_ETAG_CACHE_FILE
+    typedef struct
+    {
+      uint32_t  hash;
+      uint32_t  size;
+      uint32_t  mtime;
+      uint8_t   md5[16];
+    } Record;
+
+    static uint32_t _hash(const String& path)
+    {
+      uint32_t hash = 2166136261UL;
+
+      for (const char* c = path.c_str(); *c; c++)
+        hash = (hash ^ (uint8_t) *c) * 16777619UL;
+
+      return hash;
+    }
+
+#if defined(HTTP_ETAG_CACHE_FILE)
+
+    // Offset of the record of hash, read into record, -1 if there is none
+    static int32_t _find(File& records, uint32_t hash, Record& record)
+    {
+      int32_t offset = 0;
+
+      while (records.read((uint8_t*) &record, sizeof(record)) == sizeof(record))
+      {
+        if (record.hash == hash)
+          return offset;
+
+        offset += sizeof(record);
+      }
+
+      return -1;
+    }
+
+    // Record of the file, only valid while its size and last write time haven't changed
+    bool _load(FS& fs, uint32_t hash, uint32_t size, uint32_t mtime, uint8_t md5[16])
+    {
+      File   records = fs.open(HTTP_ETAG_CACHE_FILE, "r");
+      Record record;
+
+      if (!records)
+        return false;
+
+      bool found = (_find(records, hash, record) >= 0) && (record.size == size) && (record.mtime == mtime);
+
+      records.close();
+
+      if (found)
+        memcpy(md5, record.md5, 16);
+
+      return found;
+    }
+
+    // A changed file overwrites its record, the file only grows with the number of paths served
+    void _store(FS& fs, uint32_t hash, uint32_t size, uint32_t mtime, const uint8_t md5[16])
+    {
+      File   records = fs.open(HTTP_ETAG_CACHE_FILE, "r+");
+      Record record;
+
+      if (!records)
+        records = fs.open(HTTP_ETAG_CACHE_FILE, "w");
+
+      if (!records)
+        return;
+
+      int32_t offset = _find(records, hash, record);
+
+      if (offset < 0)
+      {
+        // New path, after the last whole record
+        offset = records.size() - (records.size() % sizeof(record));
+      }
+
+      record.hash   = hash;
+      record.size   = size;
+      record.mtime  = mtime;
+      memcpy(record.md5, md5, 16);
+
+      records.seek(offset);
+      records.write((const uint8_t*) &record, sizeof(record));
+      records.close();
+    }
+
+#endif
+
+    typedef struct
+    {
+      String    path;
+      uint32_t  size;
+      uint32_t  mtime;
+      uint8_t   md5[16];
+    } Entry;
+
+    Entry     _entries[HTTP_ETAG_CACHE_SIZE];
+    uint8_t   _next;
+};
+
+#endif  // ETAG_CACHE_H
@@ -58,14 +58,9 @@ class ethernetFunctionRequestHandler : public ethernetRequestHandler
       if (requestUri == _uri)
         return true;
 
-      if (_uri.endsWith("/*"))
-      {
-        String _uristart = _uri;
-        _uristart.replace("/*", "");
-
-        if (requestUri.startsWith(_uristart))
-          return true;
-      }
+      // "/path/*" matches anything starting with "/path", compared in place
+      if (_uri.endsWith("/*") && !strncmp(requestUri.c_str(), _uri.c_str(), _uri.length() - 2))
+        return true;
 
       return false;
     }
@@ -120,87 +115,11 @@ class ethernetStaticRequestHandler : public ethernetRequestHandler
       return true;
     }
 
-#if USE_NEW_WEBSERVER_VERSION
-
-    static String getContentType(const String& path)
-    {
-      using namespace mime;
-      char buff[sizeof(mimeTable[0].mimeType)];
-
-      // Check all entries but last one for match, return if found
-      for (size_t i = 0; i < sizeof(mimeTable) / sizeof(mimeTable[0]) - 1; i++)
-      {
-        strcpy(buff, mimeTable[i].endsWith);
-
-        if (path.endsWith(buff))
-        {
-          strcpy(buff, mimeTable[i].mimeType);
-          return String(buff);
-        }
-      }
-
-      // Fall-through and just return default type
-      strcpy(buff, mimeTable[sizeof(mimeTable) / sizeof(mimeTable[0]) - 1].mimeType);
-      return String(buff);
-    }
-
-
-#if USING_NAME_SPACE
-}
-#endif
-
-#else
-
     static String getContentType(const String& path)
     {
-      if (path.endsWith(".html"))
-        return "text/html";
-      else if (path.endsWith(".htm"))
-        return "text/html";
-      else if (path.endsWith(".css"))
-        return "text/css";
-      else if (path.endsWith(".txt"))
-        return "text/plain";
-      else if (path.endsWith(".js"))
-        return "application/javascript";
-      else if (path.endsWith(".png"))
-        return "image/png";
-      else if (path.endsWith(".gif"))
-        return "image/gif";
-      else if (path.endsWith(".jpg"))
-        return "image/jpeg";
-      else if (path.endsWith(".ico"))
-        return "image/x-icon";
-      else if (path.endsWith(".svg"))
-        return "image/svg+xml";
-      else if (path.endsWith(".ttf"))
-        return "application/x-font-ttf";
-      else if (path.endsWith(".otf"))
-        return "application/x-font-opentype";
-      else if (path.endsWith(".woff"))
-        return "application/font-woff";
-      else if (path.endsWith(".woff2"))
-        return "application/font-woff2";
-      else if (path.endsWith(".eot"))
-        return "application/vnd.ms-fontobject";
-      else if (path.endsWith(".sfnt"))
-        return "application/font-sfnt";
-      else if (path.endsWith(".xml"))
-        return "text/xml";
-      else if (path.endsWith(".pdf"))
-        return "application/pdf";
-      else if (path.endsWith(".zip"))
-        return "application/zip";
-      else if (path.endsWith(".gz"))
-        return "application/x-gzip";
-      else if (path.endsWith(".appcache"))
-        return "text/cache-manifest";
-
-      return "application/octet-stream";
+      return mime::getContentType(path.c_str());
     }
 
-#endif
-
 protected:
 
 String _uri;
@@ -0,0 +1,276 @@
+/****************************************************************************************************************************
+  RouteTree.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef ROUTE_TREE_H
+#define ROUTE_TREE_H
+
+#include "RequestHandler.h"
+
+////////////////////////////////////////
+
+// Handler registered by EthernetWebServer::on(). Only reached through the route tree, which has
+// already matched the URI, so canHandle() just checks the method
+class ethernetRouteHandler : public ethernetRequestHandler
+{
+  public:
+
+    ethernetRouteHandler(EthernetWebServer::THandlerFunction fn, EthernetWebServer::THandlerFunction ufn,
+                         const HTTPMethod& method)
+      : _fn(fn)
+      , _ufn(ufn)
+      , _methods(methodMask(method))
+    {
+    }
+
+    static uint32_t methodMask(const HTTPMethod& method)
+    {
+      if (method == HTTP_ANY)
+        return 0xFFFFFFFF;
+
+      return ((uint8_t) method < 32) ? (1UL << (uint8_t) method) : 0;
+    }
+
+    bool accepts(const HTTPMethod& requestMethod) const
+    {
+      return (_methods & methodMask(requestMethod)) != 0;
+    }
+
+    bool canHandle(const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      ETW_UNUSED(requestUri);
+
+      return accepts(requestMethod);
+    }
+
+    bool canUpload(const String& requestUri) override
+    {
+      if (!_ufn || !canHandle(HTTP_POST, requestUri))
+        return false;
+
+      return true;
+    }
+
+    bool handle(EthernetWebServer& server, const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      ETW_UNUSED(server);
+
+      if (!canHandle(requestMethod, requestUri))
+        return false;
+
+      _fn();
+      return true;
+    }
+
+    void upload(EthernetWebServer& server, const String& requestUri, const ethernetHTTPUpload& upload) override
+    {
+      ETW_UNUSED(server);
+      ETW_UNUSED(upload);
+
+      if (canUpload(requestUri))
+        _ufn();
+    }
+
+  protected:
+    EthernetWebServer::THandlerFunction _fn;
+    EthernetWebServer::THandlerFunction _ufn;
+    uint32_t    _methods;
+};
+
+////////////////////////////////////////
+
+#define ROUTE_NODE_STATIC       0     // literal path segment
+#define ROUTE_NODE_PARAM        1     // "{name}" segment, captured for pathArg()
+#define ROUTE_NODE_WILDCARD     2     // trailing "*", matches the rest of the path
+
+// Prefix tree of the routes registered by on(), keyed by path segment. "/a/{id}/*" is
+// stored as root -> "a" -> {param} -> *. Lookup walks the request URI segment by segment
+// in place, without allocating, trying literal segments before "{param}" before "*"
+class ethernetRouteNode
+{
+  public:
+
+    ethernetRouteNode(const char* segment = "", uint16_t segmentLen = 0, uint8_t type = ROUTE_NODE_STATIC)
+      : _segmentLen(segmentLen)
+      , _type(type)
+    {
+      _segment = new char[segmentLen + 1];
+      memcpy(_segment, segment, segmentLen);
+      _segment[segmentLen] = 0;
+    }
+
+    ~ethernetRouteNode()
+    {
+      ethernetRequestHandler* handler = _firstHandler;
+
+      while (handler)
+      {
+        ethernetRequestHandler* next = handler->next();
+        delete handler;
+        handler = next;
+      }
+
+      ethernetRouteNode* child = _children;
+
+      while (child)
+      {
+        ethernetRouteNode* next = child->_next;
+        delete child;
+        child = next;
+      }
+
+      delete[] _segment;
+    }
+
+    // Called on the root node. "/*" only acts as a wildcard as the last segment
+    void add(const String& uri, ethernetRequestHandler* handler)
+    {
+      ethernetRouteNode* node = this;
+      const char* segment = uri.c_str();
+
+      if (*segment == '/')
+        segment++;
+
+      while (1)
+      {
+        const char* end = strchr(segment, '/');
+        uint16_t len = end ? (end - segment) : strlen(segment);
+        uint8_t type = ROUTE_NODE_STATIC;
+
+        if ( (len >= 2) && (segment[0] == '{') && (segment[len - 1] == '}') )
+          type = ROUTE_NODE_PARAM;
+        else if ( !end && (len == 1) && (segment[0] == '*') )
+          type = ROUTE_NODE_WILDCARD;
+
+        node = node->_child(segment, len, type);
+
+        if (!end)
+          break;
+
+        segment = end + 1;
+      }
+
+      if (!node->_lastHandler)
+        node->_firstHandler = handler;
+      else
+        node->_lastHandler->next(handler);
+
+      node->_lastHandler = handler;
+    }
+
+    // Called on the root node with the request path, which starts with '/'
+    ethernetRequestHandler* find(const HTTPMethod& method, const char* uri, ethernetPathArgs& pathArgs)
+    {
+      pathArgs.count = 0;
+
+      return _find(method, uri, (*uri == '/') ? (uri + 1) : uri, pathArgs);
+    }
+
+  private:
+
+    ethernetRouteNode* _child(const char* segment, uint16_t len, uint8_t type)
+    {
+      ethernetRouteNode* last = nullptr;
+
+      for (ethernetRouteNode* child = _children; child; child = child->_next)
+      {
+        if ( (child->_type == type)
+             && ( (type != ROUTE_NODE_STATIC) || ( (child->_segmentLen == len) && !memcmp(child->_segment, segment, len) ) ) )
+        {
+          return child;
+        }
+
+        last = child;
+      }
+
+      ethernetRouteNode* child = new ethernetRouteNode(segment, len, type);
+
+      if (last)
+        last->_next = child;
+      else
+        _children = child;
+
+      return child;
+    }
+
+    ethernetRequestHandler* _handlerFor(const HTTPMethod& method)
+    {
+      for (ethernetRequestHandler* handler = _firstHandler; handler; handler = handler->next())
+      {
+        if (((ethernetRouteHandler*) handler)->accepts(method))
+          return handler;
+      }
+
+      return nullptr;
+    }
+
+    // path points to the next segment of the request, nullptr once all segments are consumed
+    ethernetRequestHandler* _find(const HTTPMethod& method, const char* uri, const char* path, ethernetPathArgs& pathArgs)
+    {
+      ethernetRequestHandler* handler;
+      ethernetRouteNode* child;
+
+      if (!path)
+      {
+        if ( (handler = _handlerFor(method)) )
+          return handler;
+      }
+      else
+      {
+        const char* end = strchr(path, '/');
+        uint16_t len = end ? (end - path) : strlen(path);
+        const char* rest = end ? (end + 1) : nullptr;
+
+        for (child = _children; child; child = child->_next)
+        {
+          if ( (child->_type == ROUTE_NODE_STATIC) && (child->_segmentLen == len) && !memcmp(child->_segment, path, len)
+               && (handler = child->_find(method, uri, rest, pathArgs)) )
+          {
+            return handler;
+          }
+        }
+
+        for (child = _children; child; child = child->_next)
+        {
+          if ( (child->_type == ROUTE_NODE_PARAM) && len && (pathArgs.count < HTTP_MAX_PATH_ARGS) )
+          {
+            pathArgs.start[pathArgs.count]  = path - uri;
+            pathArgs.length[pathArgs.count] = len;
+            pathArgs.count++;
+
+            if ( (handler = child->_find(method, uri, rest, pathArgs)) )
+              return handler;
+
+            pathArgs.count--;
+          }
+        }
+      }
+
+      for (child = _children; child; child = child->_next)
+      {
+        if ( (child->_type == ROUTE_NODE_WILDCARD) && (handler = child->_handlerFor(method)) )
+          return handler;
+      }
+
+      return nullptr;
+    }
+
+    char*                     _segment;
+    uint16_t                  _segmentLen;
+    uint8_t                   _type;
+    ethernetRouteNode*        _children       = nullptr;
+    ethernetRouteNode*        _next           = nullptr;
+    ethernetRequestHandler*   _firstHandler   = nullptr;
+    ethernetRequestHandler*   _lastHandler    = nullptr;
+};
+
+#endif  // ROUTE_TREE_H
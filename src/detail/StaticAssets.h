@@ -0,0 +1,167 @@
+/****************************************************************************************************************************
+  StaticAssets.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef STATIC_ASSETS_H
+#define STATIC_ASSETS_H
+
+#include "StaticRouter.h"
+#include "mimetable.h"
+
+////////////////////////////////////////
+
+// One file of an asset table generated by utils/pack_assets.py. The table is sorted by hash
+typedef struct
+{
+  uint32_t      hash;       // ethernetRouteHash(uri)
+  const char*   uri;
+  uint8_t       mime;       // mime::type
+  bool          gzipped;    // data is gzip encoded
+  const char*   etag;       // strong ETag, quoted
+  PGM_P         data;
+  uint32_t      length;
+  const char*   rawEtag;    // uncompressed copy of a gzipped file, kept with pack_assets.py --raw
+  PGM_P         rawData;    // nullptr if not kept
+  uint32_t      rawLength;
+} ethernetStaticAsset;
+
+////////////////////////////////////////
+
+// Serves the files packed into PROGMEM by utils/pack_assets.py, for boards without a filesystem.
+// Content-Type, ETag and the gzip encoding were resolved by the packer, so a request costs a binary
+// search and the copy of the data. A matching If-None-Match is answered with 304.
+// A gzipped file is sent to clients whose Accept-Encoding doesn't allow gzip as its uncompressed copy,
+// or with 406 if the packer didn't keep one.
+// "Range" requests are answered with 206 and the requested part of the (possibly gzipped) data
+//
+//   #include "webAssets.h"     // python3 utils/pack_assets.py data webAssets.h
+//
+//   server.addHandler(new EthernetStaticAssetHandler(webAssets));
+class EthernetStaticAssetHandler : public ethernetRequestHandler
+{
+  public:
+
+    template<size_t N>
+    explicit EthernetStaticAssetHandler(const ethernetStaticAsset (&assets)[N], const char* cacheControl = "max-age=86400")
+      : _assets(assets)
+      , _count(N)
+      , _cacheControl(cacheControl)
+    {
+    }
+
+    bool canHandle(const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      return (requestMethod == HTTP_GET) && _find(requestUri);
+    }
+
+    bool canUpload(const String& requestUri) override
+    {
+      ETW_UNUSED(requestUri);
+
+      return false;
+    }
+
+    bool handle(EthernetWebServer& server, const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      if (requestMethod != HTTP_GET)
+        return false;
+
+      const ethernetStaticAsset* asset = _find(requestUri);
+
+      if (!asset)
+        return false;
+
+      const char* etag    = asset->etag;
+      PGM_P       data    = asset->data;
+      uint32_t    size    = asset->length;
+      bool        gzipped = asset->gzipped;
+
+      server.sendHeader("Vary", "Accept-Encoding");
+
+      if ( gzipped && !server.acceptsEncoding(HTTP_ENCODING_GZIP) )
+      {
+        if (!asset->rawData)
+        {
+          server.send(406);
+          return true;
+        }
+
+        etag    = asset->rawEtag;
+        data    = asset->rawData;
+        size    = asset->rawLength;
+        gzipped = false;
+      }
+
+      server.sendHeader("ETag", etag);
+
+      if (server.ifNoneMatch(etag))
+      {
+        server.send(304);
+        return true;
+      }
+
+      if (_cacheControl)
+        server.sendHeader("Cache-Control", _cacheControl);
+
+      if (gzipped)
+        server.sendHeader("Content-Encoding", "gzip");
+
+      size_t start;
+      size_t length;
+      int    code = server.setContentRange(size, start, length);
+
+      server.send(code, mime::contentType((mime::type) asset->mime), "");
+
+      if (length)
+        server.sendContent_P(data + start, length);
+
+      return true;
+    }
+
+  protected:
+
+    // The packer sorted the table by hash, binary search for the first entry with the path's hash
+    const ethernetStaticAsset* _find(const String& uri) const
+    {
+      uint32_t hash = 2166136261UL;
+
+      for (const char* path = uri.c_str(); *path; path++)
+        hash = (hash ^ (uint8_t) *path) * 16777619UL;
+
+      size_t low  = 0;
+      size_t high = _count;
+
+      while (low < high)
+      {
+        size_t mid = (low + high) / 2;
+
+        if (_assets[mid].hash < hash)
+          low = mid + 1;
+        else
+          high = mid;
+      }
+
+      for (; (low < _count) && (_assets[low].hash == hash); low++)
+      {
+        if (!strcmp(_assets[low].uri, uri.c_str()))
+          return &_assets[low];
+      }
+
+      return nullptr;
+    }
+
+    const ethernetStaticAsset*  _assets;
+    size_t                      _count;
+    const char*                 _cacheControl;
+};
+
+#endif  // STATIC_ASSETS_H
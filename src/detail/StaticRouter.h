@@ -0,0 +1,175 @@
+/****************************************************************************************************************************
+  StaticRouter.h - Dead simple web-server.
+  For Ethernet shields
+
+  EthernetWebServer is a library for the Ethernet shields to run WebServer
+
+  Based on and modified from ESP8266 https://github.com/esp8266/Arduino/releases
+  Built by Khoi Hoang https://github.com/khoih-prog/EthernetWebServer
+  Licensed under MIT license
+ *************************************************************************************************************************************/
+
+#pragma once
+
+#ifndef STATIC_ROUTER_H
+#define STATIC_ROUTER_H
+
+#include "RequestHandler.h"
+
+////////////////////////////////////////
+
+// 32-bit FNV-1a of a path, evaluated by the compiler for the string literals of a route table
+constexpr uint32_t ethernetRouteHash(const char* path, uint32_t hash = 2166136261UL)
+{
+  return *path ? ethernetRouteHash(path + 1, (hash ^ (uint8_t) *path) * 16777619UL) : hash;
+}
+
+typedef void (*ethernetStaticRouteFunction)(void);
+
+// One entry of a route table, built with ETHERNET_STATIC_ROUTE() / ETHERNET_STATIC_UPLOAD_ROUTE()
+typedef struct
+{
+  uint32_t                      hash;     // ethernetRouteHash(uri)
+  const char*                   uri;
+  HTTPMethod                    method;
+  ethernetStaticRouteFunction   fn;
+  ethernetStaticRouteFunction   ufn;      // upload handler, nullptr if none
+} ethernetStaticRoute;
+
+#define ETHERNET_STATIC_ROUTE(method, uri, fn)                { ethernetRouteHash(uri), (uri), (method), (fn), nullptr }
+#define ETHERNET_STATIC_UPLOAD_ROUTE(method, uri, fn, ufn)    { ethernetRouteHash(uri), (uri), (method), (fn), (ufn) }
+
+////////////////////////////////////////
+
+// Fixed route table for firmware whose routes never change at runtime. Handlers are plain
+// functions and the table is a const array, so nothing is allocated. Lookup hashes the request
+// path once and binary searches the table, using a sort order built on first use.
+//
+//   static const ethernetStaticRoute routes[] =
+//   {
+//     ETHERNET_STATIC_ROUTE(HTTP_GET,  "/",       handleRoot),
+//     ETHERNET_STATIC_ROUTE(HTTP_POST, "/config", handleConfig),
+//   };
+//
+//   EthernetStaticRouter<sizeof(routes) / sizeof(routes[0])> router(routes);
+//
+//   server.setStaticRouter(router);
+template<size_t N>
+class EthernetStaticRouter : public ethernetRequestHandler
+{
+    static_assert((N > 0) && (N <= 255), "EthernetStaticRouter supports 1 to 255 routes");
+
+  public:
+
+    explicit EthernetStaticRouter(const ethernetStaticRoute (&routes)[N])
+      : _routes(routes)
+      , _sorted(false)
+    {
+    }
+
+    bool canHandle(const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      return _find(requestMethod, requestUri) != nullptr;
+    }
+
+    bool canUpload(const String& requestUri) override
+    {
+      const ethernetStaticRoute* route = _find(HTTP_POST, requestUri);
+
+      return route && route->ufn;
+    }
+
+    bool handle(EthernetWebServer& server, const HTTPMethod& requestMethod, const String& requestUri) override
+    {
+      ETW_UNUSED(server);
+
+      const ethernetStaticRoute* route = _find(requestMethod, requestUri);
+
+      if (!route)
+        return false;
+
+      route->fn();
+      return true;
+    }
+
+    void upload(EthernetWebServer& server, const String& requestUri, const ethernetHTTPUpload& upload) override
+    {
+      ETW_UNUSED(server);
+      ETW_UNUSED(upload);
+
+      const ethernetStaticRoute* route = _find(HTTP_POST, requestUri);
+
+      if (route && route->ufn)
+        route->ufn();
+    }
+
+  private:
+
+    // Same hash as ethernetRouteHash(), as a loop for the request path
+    static uint32_t _hash(const char* path)
+    {
+      uint32_t hash = 2166136261UL;
+
+      while (*path)
+        hash = (hash ^ (uint8_t) *path++) * 16777619UL;
+
+      return hash;
+    }
+
+    // Insertion sort of the table indexes by hash, once
+    void _sort()
+    {
+      for (uint8_t i = 0; i < N; i++)
+      {
+        uint8_t j = i;
+
+        while ( (j > 0) && (_routes[_order[j - 1]].hash > _routes[i].hash) )
+        {
+          _order[j] = _order[j - 1];
+          j--;
+        }
+
+        _order[j] = i;
+      }
+
+      _sorted = true;
+    }
+
+    const ethernetStaticRoute* _find(const HTTPMethod& method, const String& uri)
+    {
+      if (!_sorted)
+        _sort();
+
+      uint32_t hash = _hash(uri.c_str());
+      uint8_t  low  = 0;
+      uint8_t  high = N;
+
+      // First entry with this hash
+      while (low < high)
+      {
+        uint8_t mid = (low + high) / 2;
+
+        if (_routes[_order[mid]].hash < hash)
+          low = mid + 1;
+        else
+          high = mid;
+      }
+
+      // Entries sharing the hash: same path with other methods, or a collision
+      for (; (low < N) && (_routes[_order[low]].hash == hash); low++)
+      {
+        const ethernetStaticRoute* route = &_routes[_order[low]];
+
+        if ( ( (route->method == HTTP_ANY) || (route->method == method) ) && !strcmp(route->uri, uri.c_str()) )
+          return route;
+      }
+
+      return nullptr;
+    }
+
+    const ethernetStaticRoute*  _routes;
+    bool                        _sorted;
+    uint8_t                     _order[N];
+};
+
+#endif  // STATIC_ROUTER_H
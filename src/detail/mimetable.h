@@ -36,68 +36,149 @@
 namespace mime
 {
 
+// X(type, extension, MIME type) for every type known to getContentType(). A sketch registers more types
+// by defining EWS_MIME_EXTRA_TYPES the same way before including the library, for instance
+//   #define EWS_MIME_EXTRA_TYPES(X)   X(wasm, ".wasm", "application/wasm") X(csv, ".csv", "text/csv")
+#define EWS_MIME_TYPES(X) \
+  X(html,     ".html",      "text/html") \
+  X(htm,      ".htm",       "text/html") \
+  X(css,      ".css",       "text/css") \
+  X(txt,      ".txt",       "text/plain") \
+  X(js,       ".js",        "application/javascript") \
+  X(json,     ".json",      "application/json") \
+  X(png,      ".png",       "image/png") \
+  X(gif,      ".gif",       "image/gif") \
+  X(jpg,      ".jpg",       "image/jpeg") \
+  X(ico,      ".ico",       "image/x-icon") \
+  X(svg,      ".svg",       "image/svg+xml") \
+  X(ttf,      ".ttf",       "application/x-font-ttf") \
+  X(otf,      ".otf",       "application/x-font-opentype") \
+  X(woff,     ".woff",      "application/font-woff") \
+  X(woff2,    ".woff2",     "application/font-woff2") \
+  X(eot,      ".eot",       "application/vnd.ms-fontobject") \
+  X(sfnt,     ".sfnt",      "application/font-sfnt") \
+  X(xml,      ".xml",       "text/xml") \
+  X(pdf,      ".pdf",       "application/pdf") \
+  X(zip,      ".zip",       "application/zip") \
+  X(gz,       ".gz",        "application/x-gzip") \
+  X(appcache, ".appcache",  "text/cache-manifest")
+
+#ifndef EWS_MIME_EXTRA_TYPES
+  #define EWS_MIME_EXTRA_TYPES(X)
+#endif
+
+#define MIME_ENUM(name, extension, mimeType)     name,
+#define MIME_ENTRY(name, extension, mimeType)    { extensionHash(extension), extension, mimeType },
+
 enum type
 {
-  html,
-  htm,
-  css,
-  txt,
-  js,
-  json,
-  png,
-  gif,
-  jpg,
-  ico,
-  svg,
-  ttf,
-  otf,
-  woff,
-  woff2,
-  eot,
-  sfnt,
-  xml,
-  pdf,
-  zip,
-  gz,
-  appcache,
+  EWS_MIME_TYPES(MIME_ENUM)
+  EWS_MIME_EXTRA_TYPES(MIME_ENUM)
   none,
   maxType
 };
 
+// FNV-1a of the lower case extension, dot included
+constexpr uint32_t extensionHash(const char* extension, uint32_t hash = 2166136261UL)
+{
+  return *extension ? extensionHash(extension + 1, (hash ^ (uint8_t) ( (*extension >= 'A') && (*extension <= 'Z') ?
+                                                    *extension + 32 : *extension )) * 16777619UL) : hash;
+}
+
 struct Entry
 {
-  const char endsWith[16];
-  const char mimeType[32];
+  uint32_t    hash;         // extensionHash(endsWith)
+  const char* endsWith;
+  const char* mimeType;
 };
 
-// Table of extension->MIME strings stored in PROGMEM, needs to be global due to GCC section typing rules
+// Only the strings themselves stay in RAM on boards whose flash isn't memory mapped, so that
+// getContentType() can return them as they are
+#if ( defined(EWS_FLASH_IS_MEMORY_MAPPED) && !EWS_FLASH_IS_MEMORY_MAPPED )
+const Entry mimeTable_P[maxType] PROGMEM =
+#else
 const Entry mimeTable[maxType] =
+#endif
 {
-  { ".html",      "text/html" },
-  { ".htm",       "text/html" },
-  { ".css",       "text/css" },
-  { ".txt",       "text/plain" },
-  { ".js",        "application/javascript" },
-  { ".json",      "application/json" },
-  { ".png",       "image/png" },
-  { ".gif",       "image/gif" },
-  { ".jpg",       "image/jpeg" },
-  { ".ico",       "image/x-icon" },
-  { ".svg",       "image/svg+xml" },
-  { ".ttf",       "application/x-font-ttf" },
-  { ".otf",       "application/x-font-opentype" },
-  { ".woff",      "application/font-woff" },
-  { ".woff2",     "application/font-woff2" },
-  { ".eot",       "application/vnd.ms-fontobject" },
-  { ".sfnt",      "application/font-sfnt" },
-  { ".xml",       "text/xml" },
-  { ".pdf",       "application/pdf" },
-  { ".zip",       "application/zip" },
-  { ".gz",        "application/x-gzip" },
-  { ".appcache",  "text/cache-manifest" },
-  { "",           "application/octet-stream" }
+  EWS_MIME_TYPES(MIME_ENTRY)
+  EWS_MIME_EXTRA_TYPES(MIME_ENTRY)
+  { 0,        "",           "application/octet-stream" }
 };
-//extern const Entry mimeTable[maxType];
+
+#undef MIME_ENUM
+#undef MIME_ENTRY
+
+#if ( defined(EWS_FLASH_IS_MEMORY_MAPPED) && !EWS_FLASH_IS_MEMORY_MAPPED )
+// Keeps mimeTable[t].mimeType and mimeTable[t].endsWith working in sketches, each row is copied out of flash
+struct EntryTable
+{
+  Entry operator[](size_t i) const
+  {
+    Entry entry;
+
+    memcpy_P(&entry, &mimeTable_P[i], sizeof(entry));
+
+    return entry;
+  }
+};
+
+const EntryTable mimeTable = {};
+#endif
+
+// MIME type of a type
+inline const char* contentType(type t)
+{
+  return mimeTable[t].mimeType;
+}
+
+// Extension of a type, dot included, "" for none
+inline const char* extension(type t)
+{
+  return mimeTable[t].endsWith;
+}
+
+// Type of a path from its extension, none if unknown. The extension is hashed once, then compared
+// with the precomputed hashes of the table
+inline type getType(const char* path)
+{
+  const char* extension = nullptr;
+
+  for (const char* c = path; *c; c++)
+  {
+    if (*c == '.')
+      extension = c;
+    else if (*c == '/')
+      extension = nullptr;
+  }
+
+  if (!extension)
+    return none;
+
+  uint32_t hash = extensionHash(extension);
+
+  for (size_t i = 0; i < none; i++)
+  {
+    const Entry& e = mimeTable[i];
+
+    if ( (e.hash == hash) && !strcasecmp(e.endsWith, extension) )
+      return (type) i;
+  }
+
+  return none;
+}
+
+// For File::name() of the filesystems returning a String
+inline type getType(const String& path)
+{
+  return getType(path.c_str());
+}
+
+// MIME type of a path, "application/octet-stream" if its extension is unknown. Nothing is allocated
+inline const char* getContentType(const char* path)
+{
+  return contentType(getType(path));
+}
+
 } // namespace mime
 
 #endif    // #ifndef __MIMETABLE_H__
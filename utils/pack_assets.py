@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+#
+# pack_assets.py - Pack a directory of web files into a header for EthernetStaticAssetHandler
+#
+# Each file is gzipped (kept as is if that doesn't make it smaller), given a strong ETag and
+# a mime::type from EWS_MIME_TYPES, and emitted as a PROGMEM array. The asset index is sorted
+# by the same FNV-1a hash as ethernetRouteHash() so the handler can binary search it.
+# "dir/index.html" is also served as "/dir/". With --raw, gzipped files also keep their uncompressed
+# copy for clients not accepting gzip, which otherwise get 406.
+#
+# Usage: python3 utils/pack_assets.py [--raw] <directory> <output.h> [table name, default webAssets]
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+MIMETABLE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "detail", "mimetable.h")
+
+
+def route_hash(path):
+    h = 2166136261
+    for b in path.encode():
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+# Extension -> mime::type, read from EWS_MIME_TYPES of the library so both stay in sync
+def load_mime_table():
+    with open(MIMETABLE) as f:
+        text = f.read()
+
+    table = text[text.index("#define EWS_MIME_TYPES"):text.index("#ifndef EWS_MIME_EXTRA_TYPES")]
+    types = re.findall(r'X\((\w+),\s*"([^"]*)"\s*,\s*"[^"]*"\)', table)
+    return {ext.lower(): name for name, ext in types}
+
+
+def mime_type(name, mimes):
+    ext = os.path.splitext(name)[1].lower()
+    return "mime::" + mimes.get(ext, "none")
+
+
+def c_array(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    args = sys.argv[1:]
+    keep_raw = "--raw" in args
+    args = [a for a in args if a != "--raw"]
+
+    if len(args) < 2:
+        sys.exit("Usage: pack_assets.py [--raw] <directory> <output.h> [table name]")
+
+    root, output = args[0], args[1]
+    table = args[2] if len(args) > 2 else "webAssets"
+    mimes = load_mime_table()
+
+    files = []
+    for dirpath, _, names in os.walk(root):
+        for name in sorted(names):
+            path = os.path.join(dirpath, name)
+            files.append("/" + os.path.relpath(path, root).replace(os.sep, "/"))
+
+    arrays = []
+    entries = []
+
+    for n, uri in enumerate(sorted(files)):
+        with open(os.path.join(root, uri[1:]), "rb") as f:
+            raw = f.read()
+
+        packed = gzip.compress(raw, 9, mtime=0)
+        gzipped = len(packed) < len(raw)
+        data = packed if gzipped else raw
+        etag = '\\"%s\\"' % hashlib.sha1(data).hexdigest()[:16]
+        symbol = "%s_%d" % (table, n)
+
+        if data:
+            arrays.append("// %s, %d bytes%s\nstatic const uint8_t %s[] PROGMEM =\n{\n%s\n};\n"
+                          % (uri, len(data), (", gzipped from %d" % len(raw)) if gzipped else "", symbol, c_array(data)))
+        else:
+            # A zero-size array is ill-formed, an empty file has no data
+            symbol = "nullptr"
+
+        if gzipped and keep_raw:
+            raw_etag = '"\\"%s\\""' % hashlib.sha1(raw).hexdigest()[:16]
+            arrays.append("// %s, %d bytes uncompressed\nstatic const uint8_t %s_raw[] PROGMEM =\n{\n%s\n};\n"
+                          % (uri, len(raw), symbol, c_array(raw)))
+            raw_copy = "%s, (PGM_P) %s_raw, %d" % (raw_etag, symbol, len(raw))
+        else:
+            raw_copy = "nullptr, nullptr, 0"
+
+        aliases = [uri]
+        if uri.endswith("/index.html"):
+            aliases.append(uri[:-len("index.html")])
+
+        for alias in aliases:
+            entries.append((route_hash(alias), alias, mime_type(uri, mimes), gzipped, etag, symbol, len(data), raw_copy))
+
+    entries.sort()
+
+    with open(output, "w") as f:
+        f.write("// Generated by utils/pack_assets.py from %s, do not edit\n\n" % root)
+        f.write("#pragma once\n\n")
+        f.write("\n".join(arrays))
+        f.write("\nstatic const ethernetStaticAsset %s[] =\n{\n" % table)
+        for h, uri, mime, gzipped, etag, symbol, length, raw_copy in entries:
+            f.write('  { 0x%08xUL, "%s", %s, %s, "%s", (PGM_P) %s, %d, %s },\n'
+                    % (h, uri, mime, "true" if gzipped else "false", etag, symbol, length, raw_copy))
+        f.write("};\n")
+
+    print("%s: %d files, %d entries" % (output, len(files), len(entries)))
+
+
+if __name__ == "__main__":
+    main()